@@ -32,6 +32,7 @@
 
 #define RELAY_1 16
 
+#define ADS1015_I2C_DEV  "/dev/i2c-1"
 #define ADS1015_ADDR     0x48
 #define ADS1015_REG_CONV 0x00
 #define ADS1015_REG_CONF 0x01
@@ -56,17 +57,19 @@
  * ADS1015
  * ============================================================================ */
 
+static i2c_t *ads1015 = NULL;
+
 static float ads1015_read_channel(int channel) {
     if (channel < 0 || channel > 3)
         return -1.0f;
     static uint16_t mux_conf_ain[4] = { ADS1015_MUX_AIN0, ADS1015_MUX_AIN1, ADS1015_MUX_AIN2, ADS1015_MUX_AIN3 };
-    if (!i2c_write_reg16(ADS1015_REG_CONF, ADS1015_CONF_BASE | mux_conf_ain[channel]))
+    if (!i2c_write_reg16(ads1015, ADS1015_REG_CONF, ADS1015_CONF_BASE | mux_conf_ain[channel]))
         return -1.0f;
     /* Wait for conversion (1600 SPS = ~0.625ms per sample) */
     usleep(1000);
     /* ADS1015 is 12-bit, left-aligned in 16-bit register */
     uint16_t raw;
-    if (!i2c_read_reg16(ADS1015_REG_CONV, &raw))
+    if (!i2c_read_reg16(ads1015, ADS1015_REG_CONV, &raw))
         return -1.0f;
     /* Convert to voltage (with PGA = 4.096V) */
     return (float)(raw >> 4) * ADC_PGA_VOLTAGE / 2048.0f;
@@ -80,7 +83,8 @@ int automationhat_init(void) {
 
     if (gpio_open() < 0)
         return -1;
-    if (i2c_open(ADS1015_ADDR) < 0) {
+    ads1015 = i2c_open(ADS1015_I2C_DEV, ADS1015_ADDR);
+    if (!ads1015) {
         gpio_close();
         return -1;
     }
@@ -112,7 +116,8 @@ void automationhat_term(void) {
 
     gpio_write(RELAY_1, false);
 
-    i2c_close();
+    i2c_close(ads1015);
+    ads1015 = NULL;
     gpio_close();
 }
 
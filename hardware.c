@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include <linux/i2c-dev.h>
+#include <linux/spi/spidev.h>
+
+#include "hardware.h"
+
+// ------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------
+
+static const char *gpio_dev = "/dev/gpiomem";
+static const size_t gpio_mmap_size = 4096;
+static pthread_mutex_t gpio_lock = PTHREAD_MUTEX_INITIALIZER;
+static int gpio_refs = 0;
+
+volatile uint32_t *gpio_mem = NULL;
+
+int gpio_open(void) {
+    pthread_mutex_lock(&gpio_lock);
+    if (gpio_refs == 0) {
+        const int gpio_fd = open(gpio_dev, O_RDWR | O_SYNC);
+        if (gpio_fd < 0) {
+            perror("open: gpio_dev");
+            pthread_mutex_unlock(&gpio_lock);
+            return -1;
+        }
+        void *mem = mmap(NULL, gpio_mmap_size, PROT_READ | PROT_WRITE, MAP_SHARED, gpio_fd, 0);
+        close(gpio_fd);
+        if (mem == MAP_FAILED) {
+            perror("mmap: gpio_dev");
+            pthread_mutex_unlock(&gpio_lock);
+            return -1;
+        }
+        gpio_mem = mem;
+    }
+    gpio_refs++;
+    pthread_mutex_unlock(&gpio_lock);
+    return 0;
+}
+void gpio_close(void) {
+    pthread_mutex_lock(&gpio_lock);
+    if (gpio_refs > 0 && --gpio_refs == 0) {
+        munmap((void *)(uintptr_t)gpio_mem, gpio_mmap_size);
+        gpio_mem = NULL;
+    }
+    pthread_mutex_unlock(&gpio_lock);
+}
+/* Function select is read-modify-write on a register shared by ten pins */
+void gpio_set_input(int pin) {
+    const int reg = pin / 10, shift = (pin % 10) * 3;
+    pthread_mutex_lock(&gpio_lock);
+    gpio_mem[reg] &= (uint32_t)~(7 << shift); /* 000 = input */
+    pthread_mutex_unlock(&gpio_lock);
+}
+void gpio_set_output(int pin) {
+    const int reg = pin / 10, shift = (pin % 10) * 3;
+    pthread_mutex_lock(&gpio_lock);
+    gpio_mem[reg] = (gpio_mem[reg] & (uint32_t)~(7 << shift)) | (1 << shift); /* 001 = output */
+    pthread_mutex_unlock(&gpio_lock);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------
+
+struct i2c {
+    int fd;
+};
+
+i2c_t *i2c_open(const char *path, uint8_t addr) {
+    i2c_t *i2c = malloc(sizeof(i2c_t));
+    if (!i2c) {
+        perror("malloc");
+        return NULL;
+    }
+    i2c->fd = open(path, O_RDWR);
+    if (i2c->fd < 0) {
+        perror("open: i2c_dev");
+        free(i2c);
+        return NULL;
+    }
+    if (ioctl(i2c->fd, I2C_SLAVE, addr) < 0) {
+        perror("ioctl: i2c_dev");
+        close(i2c->fd);
+        free(i2c);
+        return NULL;
+    }
+    return i2c;
+}
+void i2c_close(i2c_t *i2c) {
+    if (!i2c)
+        return;
+    close(i2c->fd);
+    free(i2c);
+}
+int i2c_read_reg16(i2c_t *i2c, uint8_t reg, uint16_t *value) {
+    uint8_t buf[2];
+    if (write(i2c->fd, &reg, 1) != 1)
+        return 0;
+    if (read(i2c->fd, buf, sizeof(buf)) != sizeof(buf))
+        return 0;
+    *value = (uint16_t)((buf[0] << 8) | buf[1]);
+    return 1;
+}
+int i2c_write_reg16(i2c_t *i2c, uint8_t reg, uint16_t value) {
+    const uint8_t buf[3] = { reg, (uint8_t)((value >> 8) & 0xFF), (uint8_t)(value & 0xFF) };
+    return write(i2c->fd, buf, sizeof(buf)) == sizeof(buf);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------
+
+static const char *spi_bufsiz_param = "/sys/module/spidev/parameters/bufsiz";
+static const uint8_t spi_mode = SPI_MODE_0;
+static const uint8_t spi_bits = 8;
+
+static size_t spi_read_bufsiz(void) {
+    unsigned long bufsiz = 0;
+    FILE *f = fopen(spi_bufsiz_param, "r");
+    if (f) {
+        if (fscanf(f, "%lu", &bufsiz) != 1)
+            bufsiz = 0;
+        fclose(f);
+    }
+    bufsiz &= ~(unsigned long)(SPI_XFER_ALIGN - 1);
+    return bufsiz >= SPI_XFER_ALIGN ? (size_t)bufsiz : SPI_CHUNK_SIZE;
+}
+
+spi_t *spi_open(const char *path, uint32_t speed_hz) {
+    spi_t *spi = calloc(1, sizeof(spi_t));
+    if (!spi) {
+        perror("calloc");
+        return NULL;
+    }
+    spi->fd = open(path, O_RDWR);
+    if (spi->fd < 0) {
+        perror("open: spi_dev");
+        free(spi);
+        return NULL;
+    }
+    if (ioctl(spi->fd, SPI_IOC_WR_MODE, &spi_mode) < 0 || ioctl(spi->fd, SPI_IOC_WR_BITS_PER_WORD, &spi_bits) < 0 ||
+        ioctl(spi->fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed_hz) < 0)
+        goto failed;
+    spi->bufsiz = spi_read_bufsiz();
+    /* setup validates bits against the controller, as per-transfer bits_per_word will be; then back to bytes */
+    const uint8_t word16 = 16;
+    spi->word16 = ioctl(spi->fd, SPI_IOC_WR_BITS_PER_WORD, &word16) == 0;
+    if (spi->word16 && ioctl(spi->fd, SPI_IOC_WR_BITS_PER_WORD, &spi_bits) < 0)
+        goto failed;
+    return spi;
+
+failed:
+    perror("ioctl: spi_dev");
+    close(spi->fd);
+    free(spi);
+    return NULL;
+}
+void spi_close(spi_t *spi) {
+    if (!spi)
+        return;
+    close(spi->fd);
+    free(spi);
+}
+
+static void spi_message(spi_t *spi, const struct spi_ioc_transfer *tr, unsigned int n, size_t bytes) {
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (ioctl(spi->fd, SPI_IOC_MESSAGE(n), tr) < 0)
+        perror("ioctl: spi_dev");
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    const uint64_t nsec = (uint64_t)((t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec));
+    /* single writer: plain read-modify-write, atomic only so that readers see whole values */
+    atomic_store_explicit(&spi->bytes, atomic_load_explicit(&spi->bytes, memory_order_relaxed) + bytes, memory_order_relaxed);
+    atomic_store_explicit(&spi->nsec, atomic_load_explicit(&spi->nsec, memory_order_relaxed) + nsec, memory_order_relaxed);
+    atomic_store_explicit(&spi->messages, atomic_load_explicit(&spi->messages, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+void spi_counters(const spi_t *spi, spi_counters_t *counters) {
+    counters->bytes = atomic_load_explicit(&spi->bytes, memory_order_relaxed);
+    counters->nsec = atomic_load_explicit(&spi->nsec, memory_order_relaxed);
+    counters->messages = atomic_load_explicit(&spi->messages, memory_order_relaxed);
+}
+void spi_write(spi_t *spi, const uint8_t *buf, size_t len, uint32_t speed_hz) {
+    const struct spi_ioc_transfer tr = { .tx_buf = (unsigned long)buf, .len = (unsigned int)len, .speed_hz = speed_hz };
+    spi_message(spi, &tr, 1, len);
+}
+int spi_writev(spi_t *spi, const struct iovec *iov, int count, uint8_t bits, uint32_t speed_hz) {
+    struct spi_ioc_transfer tr[SPI_XFER_MAX];
+    const size_t limit = spi->bufsiz & ~(size_t)(SPI_XFER_ALIGN - 1);
+    unsigned int n = 0;
+    size_t budget = limit, bytes = 0;
+    int calls = 0;
+    for (int i = 0; i < count; i++) {
+        const uint8_t *buf = iov[i].iov_base;
+        size_t len = iov[i].iov_len;
+        while (len > 0) {
+            const size_t part = len < limit ? len : limit;
+            const size_t cost = (part + SPI_XFER_ALIGN - 1) & ~(size_t)(SPI_XFER_ALIGN - 1);
+            if (n == SPI_XFER_MAX || cost > budget) {
+                spi_message(spi, tr, n, bytes);
+                calls++;
+                n = 0;
+                budget = limit;
+                bytes = 0;
+            }
+            tr[n++] = (struct spi_ioc_transfer) {
+                .tx_buf = (unsigned long)buf, .len = (unsigned int)part, .speed_hz = speed_hz, .bits_per_word = bits
+            };
+            budget -= cost;
+            bytes += part;
+            buf += part;
+            len -= part;
+        }
+    }
+    if (n > 0) {
+        spi_message(spi, tr, n, bytes);
+        calls++;
+    }
+    return calls;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------
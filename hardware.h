@@ -1,23 +1,15 @@
-
 #ifndef _HARDWARE_H_
 #define _HARDWARE_H_
 
 // ------------------------------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------------------------------
 
-#include <stdio.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
-#include <unistd.h>
-#include <errno.h>
-#include <fcntl.h>
-
-#include <sys/ioctl.h>
-#include <sys/mman.h>
 
-#include <linux/i2c-dev.h>
-#include <linux/spi/spidev.h>
+#include <sys/uio.h>
 
 // ------------------------------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------------------------------
@@ -27,39 +19,16 @@
 #define GPIO_CLR0  10 /* Set output low */
 #define GPIO_LEV0  13 /* Read level */
 
-static const char *gpio_dev = "/dev/gpiomem";
-static const size_t gpio_mmap_size = 4096;
-static volatile uint32_t *gpio_mem = NULL;
-
-static inline int gpio_open(void) {
-    const int gpio_fd = open(gpio_dev, O_RDWR | O_SYNC);
-    if (gpio_fd < 0) {
-        perror("open: gpio_dev");
-        return -1;
-    }
-    gpio_mem = mmap(NULL, gpio_mmap_size, PROT_READ | PROT_WRITE, MAP_SHARED, gpio_fd, 0);
-    close(gpio_fd);
-    if (gpio_mem == MAP_FAILED) {
-        perror("mmap: gpio_dev");
-        gpio_mem = NULL;
-        return -1;
-    }
-    return 0;
-}
-static inline void gpio_close(void) {
-    if (gpio_mem != NULL) {
-        munmap((void *)(uintptr_t)gpio_mem, gpio_mmap_size);
-        gpio_mem = NULL;
-    }
-}
-static inline void gpio_set_input(int pin) {
-    const int reg = pin / 10, shift = (pin % 10) * 3;
-    gpio_mem[reg] &= (uint32_t)~(7 << shift); /* 000 = input */
-}
-static inline void gpio_set_output(int pin) {
-    const int reg = pin / 10, shift = (pin % 10) * 3;
-    gpio_mem[reg] = (gpio_mem[reg] & (uint32_t)~(7 << shift)) | (1 << shift); /* 001 = output */
-}
+/* One /dev/gpiomem mapping shared by every user in the process (displays, the HAT), reference counted: the first
+ * gpio_open maps it, the last gpio_close unmaps it. Reads and writes go through the level and set/clear registers and
+ * need no locking; direction changes are serialised. */
+extern volatile uint32_t *gpio_mem;
+
+int gpio_open(void);
+void gpio_close(void);
+void gpio_set_input(int pin);
+void gpio_set_output(int pin);
+
 static inline bool gpio_read(int pin) {
     return (gpio_mem[GPIO_LEV0] & (1 << pin)) != 0;
 }
@@ -70,80 +39,53 @@ static inline void gpio_write(int pin, bool value) {
 // ------------------------------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------------------------------
 
-static const char *i2c_dev = "/dev/i2c-1";
-static int i2c_fd = -1;
-
-static inline int i2c_open(uint8_t addr) {
-    i2c_fd = open(i2c_dev, O_RDWR);
-    if (i2c_fd < 0) {
-        perror("open: i2c_dev");
-        return -1;
-    }
-    if (ioctl(i2c_fd, I2C_SLAVE, addr) < 0) {
-        perror("ioctl: i2c_dev");
-        close(i2c_fd);
-        i2c_fd = -1;
-        return -1;
-    }
-    return 0;
-}
-static inline void i2c_close(void) {
-    if (i2c_fd >= 0) {
-        close(i2c_fd);
-        i2c_fd = -1;
-    }
-}
-static inline int i2c_read_reg16(uint8_t reg, uint16_t *value) {
-    uint8_t buf[2];
-    if (write(i2c_fd, &reg, 1) != 1)
-        return 0;
-    if (read(i2c_fd, buf, sizeof(buf)) != sizeof(buf))
-        return 0;
-    *value = (uint16_t)((buf[0] << 8) | buf[1]);
-    return 1;
-}
-static inline int i2c_write_reg16(uint8_t reg, uint16_t value) {
-    const uint8_t buf[3] = { reg, (uint8_t)((value >> 8) & 0xFF), (uint8_t)(value & 0xFF) };
-    return write(i2c_fd, buf, sizeof(buf)) == sizeof(buf);
-}
+/* I2C device handle, one per bus and address */
+typedef struct i2c i2c_t;
+
+i2c_t *i2c_open(const char *path, uint8_t addr); /* NULL on failure */
+void i2c_close(i2c_t *i2c);
+int i2c_read_reg16(i2c_t *i2c, uint8_t reg, uint16_t *value); /* 1 on success, 0 on failure */
+int i2c_write_reg16(i2c_t *i2c, uint8_t reg, uint16_t value);
 
 // ------------------------------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------------------------------
 
-static const char *spi_dev = "/dev/spidev0.1";
-static const uint32_t spi_speed = 16000000;
-static const uint8_t spi_mode = SPI_MODE_0;
-static const uint8_t spi_bits = 8;
-static int spi_fd = -1;
-
+/* spidev bounces each message through a bufsiz buffer: the tx lengths of all transfers in one SPI_IOC_MESSAGE, each
+ * rounded up to the kmalloc alignment, must fit in it. bufsiz is a module parameter (spidev.bufsiz=65536 on the kernel
+ * command line sends a whole frame in one message); SPI_CHUNK_SIZE is its default, used when it cannot be read. */
 #define SPI_CHUNK_SIZE 4096
-
-static inline int spi_open(void) {
-    spi_fd = open(spi_dev, O_RDWR);
-    if (spi_fd < 0) {
-        perror("open: spi_dev");
-        return -1;
-    }
-    if (ioctl(spi_fd, SPI_IOC_WR_MODE, &spi_mode) < 0 || ioctl(spi_fd, SPI_IOC_WR_BITS_PER_WORD, &spi_bits) < 0 ||
-        ioctl(spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &spi_speed) < 0) {
-        perror("ioctl: spi_dev");
-        close(spi_fd);
-        spi_fd = -1;
-        return -1;
-    }
-    return 0;
-}
-static inline void spi_close(void) {
-    if (spi_fd >= 0) {
-        close(spi_fd);
-        spi_fd = -1;
-    }
-}
-static inline void spi_write(const uint8_t *buf, size_t len) {
-    const struct spi_ioc_transfer tr = { .tx_buf = (unsigned long)buf, .len = (unsigned int)len };
-    if (ioctl(spi_fd, SPI_IOC_MESSAGE(1), &tr) < 0)
-        perror("ioctl: spi_dev");
-}
+#define SPI_XFER_ALIGN 128 /* largest ARCH_KMALLOC_MINALIGN, assumed for the budget */
+#define SPI_XFER_MAX   64  /* transfers per message */
+
+/* Transport counters: payload bytes, messages, and time spent inside SPI_IOC_MESSAGE (the kernel returns once the
+ * message is on the wire, so bytes over nsec is the achieved bus throughput) */
+typedef struct {
+    uint64_t bytes;
+    uint64_t nsec;
+    uint32_t messages;
+} spi_counters_t;
+
+/* SPI device handle, one per chip select; handles on different devices can be used from different threads. The
+ * counters are written by the thread using the handle and can be read from any other with spi_counters. */
+typedef struct {
+    int fd;
+    size_t bufsiz;           /* message budget */
+    bool word16;             /* controller accepts 16 bit words, probed at open */
+    _Atomic uint64_t bytes, nsec;
+    _Atomic uint32_t messages;
+} spi_t;
+
+/* speed_hz is the device default clock; transfers that carry their own speed_hz override it. NULL on failure. */
+spi_t *spi_open(const char *path, uint32_t speed_hz);
+void spi_close(spi_t *spi);
+void spi_counters(const spi_t *spi, spi_counters_t *counters);
+/* speed_hz 0 uses the device default, as in spi_writev */
+void spi_write(spi_t *spi, const uint8_t *buf, size_t len, uint32_t speed_hz);
+/* Gather write: segments become transfers pointing straight at the caller's memory (split at bufsiz), packed into as
+ * few messages as the bufsiz budget allows. bits is the word size for these transfers, 0 for the device setting; with
+ * 16 the controller sends each native uint16_t MSB first and segment lengths must be even. speed_hz is the clock for
+ * these transfers, 0 for the device default. Returns the number of ioctls issued. */
+int spi_writev(spi_t *spi, const struct iovec *iov, int count, uint8_t bits, uint32_t speed_hz);
 
 // ------------------------------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------------------------------
@@ -34,27 +34,12 @@ typedef struct {
 
 static struct {
     st7735_t *disp;
+    st7735_ui_t *ui;
 
-    const fontinfo_t *font_status;
-    const fontinfo_t *font_abbrev;
-    const fontinfo_t *font_text;
-
-    int status_x;
-    int status_y;
-    int status_h;
-
-    int main_y;
-    int main_h;
-
-    int abbrev_x;
-    int abbrev_y;
-    int abbrev_w;
-    int abbrev_h;
-
-    int line_x;
-    int line1_y;
-    int line2_y;
-    int line_x_max;
+    st7735_widget_t *status;
+    st7735_widget_t *abbrev;
+    st7735_widget_t *line1;
+    st7735_widget_t *line2;
 
 } ui;
 
@@ -65,6 +50,15 @@ static int calc_text_width(const fontinfo_t *font, const char *text) {
     return width;
 }
 
+void ui_cleanup(void) {
+    st7735_ui_destroy(ui.ui);
+    ui.ui = NULL;
+    if (ui.disp) {
+        st7735_close(ui.disp);
+        ui.disp = NULL;
+    }
+}
+
 int ui_setup(const ui_config_t *config) {
 
     /* Initialize display - 270° rotation = 160x80 landscape */
@@ -77,70 +71,72 @@ int ui_setup(const ui_config_t *config) {
     /* Enable framebuffer mode */
     st7735_set_buffered(ui.disp, true);
 
-    /* Copy font config */
-    ui.font_status = config->font_status;
-    ui.font_abbrev = config->font_abbrev;
-    ui.font_text = config->font_text;
-
     const int disp_w = st7735_width(ui.disp);
     const int disp_h = st7735_height(ui.disp);
 
-    /* Status bar at bottom */
-    ui.status_h = ui.font_status->height + 4; /* font + 2px padding top/bottom */
-    ui.status_y = disp_h - ui.status_h;
-    ui.status_x = 4;
+    /* Status bar at bottom, raised slightly off the edge */
+    const int status_h = config->font_status->height + 4; /* font + 2px padding top/bottom */
+    const int status_y = disp_h - status_h - 5;
 
     /* Main area above status bar */
-    ui.main_y = 0;
-    ui.main_h = ui.status_y;
+    const int main_h = disp_h - status_h;
 
     /* Calculate abbreviation box width from max abbreviation */
     int max_abbrev_w = 0;
     for (const char **abbr = config->abbreviations; *abbr != NULL; abbr++) {
-        const int w = calc_text_width(ui.font_abbrev, *abbr);
+        const int w = calc_text_width(config->font_abbrev, *abbr);
         if (w > max_abbrev_w)
             max_abbrev_w = w;
     }
-    ui.abbrev_w = max_abbrev_w + (config->abbrev_padding * 2);
-    ui.abbrev_h = ui.font_abbrev->height + (config->abbrev_padding * 2);
-    ui.abbrev_x = 5;
-    ui.abbrev_y = (ui.main_h - ui.abbrev_h) / 2; /* Centered vertically */
+    const int abbrev_w = max_abbrev_w + (config->abbrev_padding * 2);
+    const int abbrev_h = config->font_abbrev->height + (config->abbrev_padding * 2);
+    const int abbrev_x = 5;
+    const int abbrev_y = (main_h - abbrev_h) / 2; /* Centered vertically */
 
     /* Text lines - to the right of abbreviation box */
-    ui.line_x = ui.abbrev_x + ui.abbrev_w + 8;
-    ui.line_x_max = disp_w - ui.line_x - 2;
+    const int line_x = abbrev_x + abbrev_w + 8;
+    const int line_w = disp_w - line_x - 2;
 
     /* Vertically center two text lines in main area */
-    const int text_total_h = (ui.font_text->height * 2) + 2; /* 2px gap */
-    const int text_start_y = (ui.main_h - text_total_h) / 2;
-    ui.line1_y = text_start_y;
-    ui.line2_y = text_start_y + ui.font_text->height + 2;
+    const int text_total_h = (config->font_text->height * 2) + 2; /* 2px gap */
+    const int line1_y = (main_h - text_total_h) / 2;
+    const int line2_y = line1_y + config->font_text->height + 2;
+
+    /* Widgets redraw only when their content changes */
+    ui.ui = st7735_ui_create(ui.disp);
+    if (!ui.ui) {
+        ui_cleanup();
+        return -1;
+    }
+    ui.status = st7735_statusbar_create(ui.ui, status_y, status_h, UI_STATUS_FG, UI_STATUS_BG);
+    ui.abbrev = st7735_badge_create(ui.ui, abbrev_x, abbrev_y, abbrev_w, abbrev_h, UI_ABBREV_FG, UI_ABBREV_IDLE);
+    ui.line1 = st7735_label_create(ui.ui, line_x, line1_y, line_w, config->font_text->height, COLOR_WHITE, UI_MAIN_BG);
+    ui.line2 = st7735_label_create(ui.ui, line_x, line2_y, line_w, config->font_text->height, COLOR_WHITE, UI_MAIN_BG);
+    if (!ui.status || !ui.abbrev || !ui.line1 || !ui.line2) {
+        ui_cleanup();
+        return -1;
+    }
+    st7735_widget_set_align(ui.status, ST7735_ALIGN_LEFT, abbrev_x);
+    st7735_widget_set_font(ui.status, config->font_status, false);
+    st7735_widget_set_font(ui.abbrev, config->font_abbrev, false);
+    st7735_widget_set_font(ui.line1, config->font_text, false);
+    st7735_widget_set_font(ui.line2, config->font_text, false);
 
     /* Clear display */
     st7735_fill(ui.disp, UI_MAIN_BG);
-
-    ui.status_x = ui.abbrev_x;
-    ui.status_y -= 5;
-
     st7735_flush(ui.disp);
 
     printf("UI initialized: %dx%d\n", disp_w, disp_h);
-    printf("  Status bar: y=%d, h=%d\n", ui.status_y, ui.status_h);
-    printf("  Main area: y=%d, h=%d\n", ui.main_y, ui.main_h);
-    printf("  Abbrev box: x=%d, y=%d, w=%d, h=%d (max_text_w=%d)\n", ui.abbrev_x, ui.abbrev_y, ui.abbrev_w, ui.abbrev_h, max_abbrev_w);
-    printf("  Text lines: x=%d, y1=%d, y2=%d\n", ui.line_x, ui.line1_y, ui.line2_y);
+    printf("  Status bar: y=%d, h=%d\n", status_y, status_h);
+    printf("  Main area: y=%d, h=%d\n", 0, main_h);
+    printf("  Abbrev box: x=%d, y=%d, w=%d, h=%d (max_text_w=%d)\n", abbrev_x, abbrev_y, abbrev_w, abbrev_h, max_abbrev_w);
+    printf("  Text lines: x=%d, y1=%d, y2=%d\n", line_x, line1_y, line2_y);
 
     return 0;
 }
 
-void ui_cleanup(void) {
-    if (ui.disp) {
-        st7735_close(ui.disp);
-        ui.disp = NULL;
-    }
-}
-
 void ui_flush(void) {
+    st7735_ui_render(ui.ui);
     st7735_flush(ui.disp);
 }
 
@@ -150,9 +146,7 @@ void ui_set_status(const char *fmt, ...) {
     va_start(args, fmt);
     vsnprintf(text, sizeof(text), fmt, args);
     va_end(args);
-    st7735_fill_rect(ui.disp, 0, ui.status_y, st7735_width(ui.disp), ui.status_h, UI_STATUS_BG);
-    const int text_y = ui.status_y + 2;
-    st7735_text_font(ui.disp, ui.status_x, text_y, UI_STATUS_FG, UI_STATUS_BG, ui.font_status, false, 1, text);
+    st7735_widget_set_text(ui.status, text);
 }
 void ui_set_abbrev(uint16_t color_bg, const char *fmt, ...) {
     char text[64];
@@ -160,10 +154,8 @@ void ui_set_abbrev(uint16_t color_bg, const char *fmt, ...) {
     va_start(args, fmt);
     vsnprintf(text, sizeof(text), fmt, args);
     va_end(args);
-    st7735_fill_rect(ui.disp, ui.abbrev_x, ui.abbrev_y, ui.abbrev_w, ui.abbrev_h, color_bg);
-    const int line_x = ui.abbrev_x + (ui.abbrev_w - calc_text_width(ui.font_abbrev, text)) / 2;
-    const int text_y = ui.abbrev_y + (ui.abbrev_h - ui.font_abbrev->height) / 2;
-    st7735_text_font(ui.disp, line_x, text_y, UI_ABBREV_FG, color_bg, ui.font_abbrev, false, 0, text);
+    st7735_widget_set_colors(ui.abbrev, UI_ABBREV_FG, color_bg);
+    st7735_widget_set_text(ui.abbrev, text);
 }
 void ui_set_line(int num, uint16_t color, const char *fmt, ...) {
     char text[64];
@@ -171,8 +163,9 @@ void ui_set_line(int num, uint16_t color, const char *fmt, ...) {
     va_start(args, fmt);
     vsnprintf(text, sizeof(text), fmt, args);
     va_end(args);
-    st7735_fill_rect(ui.disp, ui.line_x, num == 1 ? ui.line1_y : ui.line2_y, ui.line_x_max, ui.font_text->height, UI_MAIN_BG);
-    st7735_text_font(ui.disp, ui.line_x, num == 1 ? ui.line1_y : ui.line2_y, color, UI_MAIN_BG, ui.font_text, false, 1, text);
+    st7735_widget_t *line = num == 1 ? ui.line1 : ui.line2;
+    st7735_widget_set_colors(line, color, UI_MAIN_BG);
+    st7735_widget_set_text(line, text);
 }
 
 /* ============================================================================
@@ -2,12 +2,24 @@
 // ------------------------------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------------------------------
 
+#define _GNU_SOURCE /* CPU affinity */
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/mman.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
 
 #include "hardware.h"
 #include "st7735.h"
@@ -39,11 +51,84 @@
 #define ST7735_GMCTRP1  0xE0
 #define ST7735_GMCTRN1  0xE1
 
+#define ST7735_FOSC 850000 /* nominal panel oscillator, Hz; the frame rate follows it within a few percent */
+
 #define ST7735_COLS   132
 #define ST7735_ROWS   162
 #define ST7735_WIDTH  80
 #define ST7735_HEIGHT 160
 
+typedef struct {
+    int x, y, w, h;
+} save_rect_t;
+
+/* Palette framebuffer: 4 or 8 bit indices, expanded through the wire-order palette at flush */
+typedef struct {
+    uint8_t *pixels;
+    int bpp, stride;            /* bits per pixel, bytes per row */
+    int count;                  /* palette entries in use */
+    uint16_t colors[256];       /* RGB565, unused entries repeat entry 0 */
+    uint16_t wire[256];         /* the same in panel byte order */
+    uint32_t wire_pairs[256];   /* 4 bpp: both pixels of one byte, left pixel in the high nibble */
+    uint16_t cache_color[16];   /* recent colour to index matches */
+    uint8_t cache_index[16];
+} indexed_t;
+
+/* Log-linear histogram of microseconds: exact below LATENCY_SUB, then LATENCY_SUB buckets per power of two (within
+ * 12.5%). One thread records, any thread may read, so the fields are atomics used as plain loads and stores. A reset
+ * from another thread only raises resets_requested; the recording thread clears the histogram before its next sample,
+ * and readers report it empty until it has. */
+#define LATENCY_SUB     8
+#define LATENCY_BUCKETS (LATENCY_SUB * 24)
+
+typedef struct {
+    _Atomic uint32_t buckets[LATENCY_BUCKETS];
+    _Atomic uint64_t count, total_us;
+    _Atomic uint32_t min_us, max_us;
+    _Atomic uint32_t resets_requested, resets_done;
+} latency_t;
+
+/* Cost counters, written like the histogram: by the drawing thread only, readable from any. A reset never writes
+ * them: it copies them into a baseline that reads subtract, so counts made meanwhile are not lost. */
+typedef struct {
+    _Atomic uint64_t commands, windows, pixels;
+    _Atomic uint64_t pixel_calls, flushes;
+    _Atomic uint64_t flush_convert_ns, flush_transfer_ns;
+    _Atomic uint64_t spi_bytes, spi_nsec, spi_messages; /* baseline and snapshots only, the transport keeps the live values */
+} counters_t;
+
+static inline void counter_add(_Atomic uint64_t *counter, uint64_t n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+/* Timeline trace: complete events (start and duration) in a ring preallocated at start, oldest overwritten */
+typedef struct {
+    uint64_t start_ns, dur_ns;
+    const char *name, *arg_name; /* static strings */
+    uint32_t arg;
+} trace_event_t;
+
+typedef struct {
+    trace_event_t *events;
+    uint32_t capacity;
+    uint64_t recorded;
+    bool recording;
+} trace_t;
+
+/* What st7735_set_realtime found on the calling thread, for st7735_clear_realtime to put back */
+typedef struct {
+    bool saved;
+    int policy;
+    struct sched_param param;
+    cpu_set_t affinity;
+    bool locked; /* memory locked by us, not by the application */
+} realtime_saved_t;
+
+typedef struct {
+    int org_x, org_y;      /* drawing origin */
+    int x1, y1, x2, y2;    /* clip, end exclusive */
+} view_t;                  /* both in screen coordinates */
+
 struct st7735 {
     uint8_t pin_dc;
     uint8_t pin_bl;
@@ -54,57 +139,192 @@ struct st7735 {
     uint8_t offset_left;
     uint8_t offset_top;
 
+    spi_t *spi;
+
     size_t pixels;
     uint8_t *tmpbuf;
+    bool word16; /* pixel data as 16 bit SPI words, no byte swapping */
+    bool rgb444; /* 12 bit interface, pixels packed two to three bytes at send */
+    uint32_t speed_hz;     /* SPI clock for pixel data */
+    uint32_t cmd_speed_hz; /* and for commands and their parameters */
 
-    uint16_t *buffer;
+    st7735_surface_t screen; /* framebuffer, pixels NULL when unbuffered or indexed */
+    indexed_t *indexed;      /* palette framebuffer replacing screen.pixels, NULL when off */
 
     int dirty_x1, dirty_y1;
     int dirty_x2, dirty_y2;
     bool dirty;
+
+    struct render_pool *render; /* banded parallel rendering, NULL when off */
+
+    save_rect_t *saves; /* save-under stack, pixels kept LIFO in one reused pool */
+    int saves_count, saves_capacity;
+    uint16_t *saved;
+    size_t saved_used, saved_size;
+
+    view_t *views; /* clip / viewport stack for the drawing calls, empty means whole screen */
+    int views_count, views_capacity;
+
+    uint64_t frame_period_ns; /* flush pacing, 0 when off */
+    uint64_t frame_next_ns;   /* next deadline, CLOCK_MONOTONIC */
+    st7735_frame_stats_t frame_stats;
+
+    latency_t flush_latency;
+    counters_t counters;
+    counters_t counters_base; /* values at the last reset */
+    _Atomic uint32_t counters_seq; /* seqlock over the baseline, odd while a reset writes it */
+
+    trace_t *trace; /* NULL until tracing is first started */
+
+    realtime_saved_t realtime_saved;
 };
 
+static void render_pool_destroy(struct render_pool *pool);
+static void flush_now(st7735_t *disp);
+
+// ------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------
+
+static inline uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* A stage is timed as trace_begin ... trace_end; when tracing is off that is one test on each side */
+static inline uint64_t trace_begin(const st7735_t *disp) {
+    return disp->trace && disp->trace->recording ? monotonic_ns() : 0;
+}
+static void trace_end(const st7735_t *disp, uint64_t begin, const char *name, const char *arg_name, uint32_t arg) {
+    if (!begin || !disp->trace->recording)
+        return;
+    trace_t *t = disp->trace;
+    t->events[t->recorded++ % t->capacity] =
+        (trace_event_t) { .start_ns = begin, .dur_ns = monotonic_ns() - begin, .name = name, .arg_name = arg_name, .arg = arg };
+}
+
 // ------------------------------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------------------------------
 
-static void cmd(const st7735_t *disp, uint8_t c) {
+static void cmd(st7735_t *disp, uint8_t c) {
+    counter_add(&disp->counters.commands, 1);
     gpio_write(disp->pin_dc, false);
-    spi_write(&c, 1);
+    spi_write(disp->spi, &c, 1, disp->cmd_speed_hz);
 }
 static void dat(const st7735_t *disp, uint8_t d) {
     gpio_write(disp->pin_dc, true);
-    spi_write(&d, 1);
+    spi_write(disp->spi, &d, 1, disp->cmd_speed_hz);
 }
 static void dat_buf(const st7735_t *disp, const uint8_t *buf, size_t len) {
+    const struct iovec iov = { (void *)(uintptr_t)buf, len };
+    gpio_write(disp->pin_dc, true);
+    spi_writev(disp->spi, &iov, 1, 0, disp->cmd_speed_hz);
+}
+/* Pixel data already in panel byte order, at the pixel clock */
+static void dat_bytes(const st7735_t *disp, const uint8_t *buf, size_t len) {
+    const struct iovec iov = { (void *)(uintptr_t)buf, len };
+    const uint64_t trace = trace_begin(disp);
+    gpio_write(disp->pin_dc, true);
+    spi_writev(disp->spi, &iov, 1, 0, disp->speed_hz);
+    trace_end(disp, trace, "spi", "bytes", (uint32_t)len);
+}
+
+/* Whether RGB565 can go out as it sits in memory: always on big-endian CPUs, else with 16 bit SPI words */
+static inline bool pixels_native(const st7735_t *disp) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    (void)disp;
+    return true;
+#else
+    return disp->word16;
+#endif
+}
+/* Native RGB565 from several places in one go, e.g. framebuffer rows of a partial-width window */
+static void dat_pixels(const st7735_t *disp, const struct iovec *iov, int count) {
+    const uint64_t trace = trace_begin(disp);
     gpio_write(disp->pin_dc, true);
-    while (len > 0) {
-        const size_t n = (len < SPI_CHUNK_SIZE) ? len : SPI_CHUNK_SIZE;
-        spi_write(buf, n);
-        buf += n;
-        len -= n;
+    spi_writev(disp->spi, iov, count, disp->word16 ? 16 : 0, disp->speed_hz);
+    size_t bytes = 0;
+    for (int i = 0; i < count; i++)
+        bytes += iov[i].iov_len;
+    trace_end(disp, trace, "spi", "bytes", (uint32_t)bytes);
+}
+
+/* 12 bit interface (COLMOD 0x03): two pixels in three bytes, RRRRGGGG BBBBRRRR GGGGBBBB, each RGB565 channel truncated
+ * to 4 bits. Safe in place (out == in): every block is loaded before it is stored and the output trails the input. An
+ * odd count ends with the last pixel padded to two bytes; the panel drops the unfinished pixel at the next command.
+ * Returns the number of bytes written. */
+static size_t rgb444_pack(uint8_t *out, const uint16_t *in, size_t count) {
+    uint8_t *o = out;
+    size_t i = 0;
+#ifdef __ARM_NEON
+    const uint16x8_t hi = vdupq_n_u16(0xF0), lo = vdupq_n_u16(0x0F);
+    for (; i + 16 <= count; i += 16, o += 24) {
+        const uint16x8x2_t p = vld2q_u16(in + i); /* even and odd pixels */
+        const uint16x8_t a = p.val[0], b = p.val[1];
+        uint8x8x3_t v;
+        v.val[0] = vmovn_u16(vorrq_u16(vandq_u16(vshrq_n_u16(a, 8), hi), vandq_u16(vshrq_n_u16(a, 7), lo)));
+        v.val[1] = vmovn_u16(vorrq_u16(vandq_u16(vshlq_n_u16(a, 3), hi), vshrq_n_u16(b, 12)));
+        v.val[2] = vmovn_u16(vorrq_u16(vandq_u16(vshrq_n_u16(b, 3), hi), vandq_u16(vshrq_n_u16(b, 1), lo)));
+        vst3_u8(o, v);
+    }
+#endif
+    for (; i + 2 <= count; i += 2, o += 3) {
+        const uint16_t a = in[i], b = in[i + 1];
+        o[0] = (uint8_t)(((a >> 8) & 0xF0) | ((a >> 7) & 0x0F));
+        o[1] = (uint8_t)(((a << 3) & 0xF0) | (b >> 12));
+        o[2] = (uint8_t)(((b >> 3) & 0xF0) | ((b >> 1) & 0x0F));
+    }
+    if (i < count) {
+        const uint16_t a = in[i];
+        o[0] = (uint8_t)(((a >> 8) & 0xF0) | ((a >> 7) & 0x0F));
+        o[1] = (uint8_t)((a << 3) & 0xF0);
+        o += 2;
+    }
+    return (size_t)(o - out);
+}
+
+/* Native RGB565 staged at the start of tmpbuf to the panel in its interface format, converting the staging in place */
+static void dat_staged(const st7735_t *disp, size_t count) {
+    uint16_t *px = (uint16_t *)(void *)disp->tmpbuf;
+    if (disp->rgb444) {
+        const uint64_t trace = trace_begin(disp);
+        const size_t len = rgb444_pack(disp->tmpbuf, px, count);
+        trace_end(disp, trace, "convert", "pixels", (uint32_t)count);
+        dat_bytes(disp, disp->tmpbuf, len);
+    } else if (pixels_native(disp)) {
+        const struct iovec iov = { disp->tmpbuf, count * 2 };
+        dat_pixels(disp, &iov, 1);
+    } else {
+        const uint64_t trace = trace_begin(disp);
+        for (size_t i = 0; i < count; i++)
+            px[i] = (uint16_t)((px[i] >> 8) | (px[i] << 8));
+        trace_end(disp, trace, "convert", "pixels", (uint32_t)count);
+        dat_bytes(disp, disp->tmpbuf, count * 2);
     }
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------------------------------
 
-static void set_window(const st7735_t *disp, int x0, int y0, int x1, int y1) {
+/* DC is a GPIO, so commands and their parameters cannot share a message: 5 transfers rather than one per byte */
+static void set_window(st7735_t *disp, int x0, int y0, int x1, int y1) {
+    const uint32_t area = (uint32_t)((x1 - x0 + 1) * (y1 - y0 + 1));
+    counter_add(&disp->counters.windows, 1);
+    counter_add(&disp->counters.pixels, area);
+    const uint64_t trace = trace_begin(disp);
+    const uint8_t cols[4] = { 0x00, (uint8_t)(x0 + disp->offset_left), 0x00, (uint8_t)(x1 + disp->offset_left) };
+    const uint8_t rows[4] = { 0x00, (uint8_t)(y0 + disp->offset_top), 0x00, (uint8_t)(y1 + disp->offset_top) };
     cmd(disp, ST7735_CASET);
-    dat(disp, 0x00);
-    dat(disp, (uint8_t)(x0 + disp->offset_left));
-    dat(disp, 0x00);
-    dat(disp, (uint8_t)(x1 + disp->offset_left));
+    dat_buf(disp, cols, sizeof(cols));
     cmd(disp, ST7735_RASET);
-    dat(disp, 0x00);
-    dat(disp, (uint8_t)(y0 + disp->offset_top));
-    dat(disp, 0x00);
-    dat(disp, (uint8_t)(y1 + disp->offset_top));
+    dat_buf(disp, rows, sizeof(rows));
     cmd(disp, ST7735_RAMWR);
+    trace_end(disp, trace, "window", "pixels", area);
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
 
-static void init_seq(const st7735_t *disp) {
+static void init_seq(st7735_t *disp) {
     cmd(disp, ST7735_SWRESET);
     usleep(150000);
 
@@ -167,7 +387,7 @@ static void init_seq(const st7735_t *disp) {
     dat(disp, madctl | 0x08);
 
     cmd(disp, ST7735_COLMOD);
-    dat(disp, 0x05);
+    dat(disp, disp->rgb444 ? 0x03 : 0x05);
 
     cmd(disp, ST7735_CASET);
     dat(disp, 0x00);
@@ -202,11 +422,19 @@ static void init_seq(const st7735_t *disp) {
 // ------------------------------------------------------------------------------------------------------------------------
 
 st7735_t *st7735_init(int pin_dc, int pin_bl, int rotation) {
+    const st7735_config_t config = { .pin_dc = pin_dc, .pin_bl = pin_bl, .rotation = rotation };
+    return st7735_init_ex(&config);
+}
 
-    if (spi_open() < 0)
+st7735_t *st7735_init_ex(const st7735_config_t *config) {
+    const int pin_dc = config->pin_dc, pin_bl = config->pin_bl, rotation = config->rotation;
+    const uint32_t cmd_speed_hz = config->cmd_speed_hz ? config->cmd_speed_hz : ST7735_CMD_SPEED_DEFAULT;
+
+    spi_t *spi = spi_open(config->spi_dev ? config->spi_dev : ST7735_SPI_DEVICE, cmd_speed_hz);
+    if (!spi)
         return NULL;
     if (gpio_open() < 0) {
-        spi_close();
+        spi_close(spi);
         return NULL;
     }
 
@@ -218,9 +446,14 @@ st7735_t *st7735_init(int pin_dc, int pin_bl, int rotation) {
 
     disp->pin_dc = (uint8_t)pin_dc;
     disp->pin_bl = (uint8_t)pin_bl;
-    disp->buffer = NULL;
     disp->dirty = false;
 
+    disp->spi = spi;
+    disp->word16 = spi->word16;
+    disp->speed_hz = config->speed_hz ? config->speed_hz : ST7735_SPEED_DEFAULT;
+    disp->cmd_speed_hz = cmd_speed_hz;
+    disp->rgb444 = config->color_depth == 12;
+
     disp->rotation = rotation;
     if (rotation == 0 || rotation == 180) {
         disp->width = ST7735_WIDTH;
@@ -234,6 +467,8 @@ st7735_t *st7735_init(int pin_dc, int pin_bl, int rotation) {
         disp->offset_top = (ST7735_COLS - ST7735_WIDTH) / 2;
     }
 
+    st7735_surface_init(&disp->screen, NULL, disp->width, disp->height, disp->width);
+
     disp->pixels = disp->width * disp->height;
     disp->tmpbuf = malloc(disp->pixels * sizeof(uint16_t));
     if (!disp->tmpbuf) {
@@ -252,7 +487,7 @@ st7735_t *st7735_init(int pin_dc, int pin_bl, int rotation) {
 
 failed:
     gpio_close();
-    spi_close();
+    spi_close(spi);
     return NULL;
 }
 
@@ -264,14 +499,25 @@ void st7735_close(st7735_t *disp) {
 
     gpio_write(disp->pin_bl, false); /* Backlight off */
 
-    if (disp->buffer)
-        free(disp->buffer);
+    render_pool_destroy(disp->render);
+    free(disp->saves);
+    free(disp->saved);
+    free(disp->views);
+    if (disp->trace)
+        free(disp->trace->events);
+    free(disp->trace);
+    if (disp->indexed)
+        free(disp->indexed->pixels);
+    free(disp->indexed);
+
+    if (disp->screen.pixels)
+        free(disp->screen.pixels);
     if (disp->tmpbuf)
         free(disp->tmpbuf);
+    spi_close(disp->spi);
     free(disp);
 
     gpio_close();
-    spi_close();
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
@@ -292,175 +538,1149 @@ void st7735_backlight(st7735_t *disp, bool on) {
 
 // ------------------------------------------------------------------------------------------------------------------------
 
+/* Palette framebuffer. Drawing still takes RGB565: a colour maps to the nearest palette entry, and a small cache
+ * keyed on the colour makes repeats (glyph fg/bg, fills) a compare. Flush expands the dirty rows through the wire-order
+ * palette straight into tmpbuf, one table read per pixel, or per pixel pair at 4 bpp. */
+static void indexed_palette(indexed_t *ix, const uint16_t *palette, int count) {
+    ix->count = count;
+    for (int i = 0; i < 256; i++) {
+        const uint16_t c = palette[i < count ? i : 0];
+        const uint8_t bytes[2] = { (uint8_t)(c >> 8), (uint8_t)(c & 0xFF) };
+        ix->colors[i] = c;
+        memcpy(&ix->wire[i], bytes, sizeof(bytes));
+    }
+    for (int i = 0; i < 256; i++) {
+        const uint16_t pair[2] = { ix->wire[i >> 4], ix->wire[i & 0x0F] };
+        memcpy(&ix->wire_pairs[i], pair, sizeof(pair));
+    }
+    for (int i = 0; i < 16; i++) {
+        ix->cache_color[i] = ix->colors[0];
+        ix->cache_index[i] = 0;
+    }
+}
+
+/* Nearest entry, distance over 6 bit channels */
+static uint8_t indexed_match(indexed_t *ix, uint16_t color) {
+    const int slot = (color ^ (color >> 4) ^ (color >> 8) ^ (color >> 12)) & 0x0F;
+    if (ix->cache_color[slot] == color)
+        return ix->cache_index[slot];
+    int best = 0, best_d = INT_MAX;
+    for (int i = 0; i < ix->count && best_d > 0; i++) {
+        const int dr = 2 * ((color >> 11) - (ix->colors[i] >> 11)), dg = ((color >> 5) & 0x3F) - ((ix->colors[i] >> 5) & 0x3F),
+                  db = 2 * ((color & 0x1F) - (ix->colors[i] & 0x1F));
+        const int d = dr * dr + dg * dg + db * db;
+        if (d < best_d)
+            best = i, best_d = d;
+    }
+    ix->cache_color[slot] = color;
+    ix->cache_index[slot] = (uint8_t)best;
+    return (uint8_t)best;
+}
+
+static inline void indexed_set(indexed_t *ix, int x, int y, uint8_t index) {
+    uint8_t *p = ix->pixels + y * ix->stride;
+    if (ix->bpp == 8)
+        p[x] = index;
+    else if (x & 1)
+        p[x >> 1] = (uint8_t)((p[x >> 1] & 0xF0) | index);
+    else
+        p[x >> 1] = (uint8_t)((p[x >> 1] & 0x0F) | index << 4);
+}
+
+static inline uint8_t indexed_get(const indexed_t *ix, int x, int y) {
+    const uint8_t *p = ix->pixels + y * ix->stride;
+    if (ix->bpp == 8)
+        return p[x];
+    return (x & 1) ? p[x >> 1] & 0x0F : p[x >> 1] >> 4;
+}
+
+static void indexed_fill(indexed_t *ix, int x, int y, int w, int h, uint16_t color) {
+    const uint8_t index = indexed_match(ix, color);
+    for (int py = y; py < y + h; py++) {
+        int px = x, n = w;
+        if (ix->bpp == 8) {
+            memset(ix->pixels + py * ix->stride + px, index, (size_t)n);
+            continue;
+        }
+        if (px & 1) {
+            indexed_set(ix, px++, py, index);
+            n--;
+        }
+        memset(ix->pixels + py * ix->stride + (px >> 1), index * 0x11, (size_t)(n >> 1));
+        if (n & 1)
+            indexed_set(ix, px + n - 1, py, index);
+    }
+}
+
+/* Store w x h RGB565 pixels (rows packed) as indices */
+static void indexed_store(indexed_t *ix, const uint16_t *src, int x, int y, int w, int h) {
+    uint16_t last = src[0];
+    uint8_t index = indexed_match(ix, last);
+    for (int py = 0; py < h; py++)
+        for (int px = 0; px < w; px++, src++) {
+            if (*src != last) {
+                last = *src;
+                index = indexed_match(ix, last);
+            }
+            indexed_set(ix, x + px, y + py, index);
+        }
+}
+
+static void indexed_flush(st7735_t *disp, int x1, int y1, int x2, int y2) {
+    const indexed_t *ix = disp->indexed;
+    uint16_t *out = (uint16_t *)(void *)disp->tmpbuf;
+    const uint32_t area = (uint32_t)((x2 - x1 + 1) * (y2 - y1 + 1));
+    const uint64_t trace = trace_begin(disp);
+    if (disp->rgb444) {
+        for (int y = y1; y <= y2; y++)
+            for (int x = x1; x <= x2; x++)
+                *out++ = ix->colors[indexed_get(ix, x, y)];
+        trace_end(disp, trace, "convert", "pixels", area);
+        set_window(disp, x1, y1, x2, y2);
+        dat_staged(disp, (size_t)((x2 - x1 + 1) * (y2 - y1 + 1)));
+        return;
+    }
+    for (int y = y1; y <= y2; y++) {
+        const uint8_t *row = ix->pixels + y * ix->stride;
+        int x = x1;
+        if (ix->bpp == 8) {
+            for (; x <= x2; x++)
+                *out++ = ix->wire[row[x]];
+            continue;
+        }
+        if (x & 1)
+            *out++ = ix->wire[row[x++ >> 1] & 0x0F];
+        for (; x < x2; x += 2, out += 2)
+            memcpy(out, &ix->wire_pairs[row[x >> 1]], sizeof(uint32_t));
+        if (x == x2)
+            *out++ = ix->wire[row[x >> 1] >> 4];
+    }
+    trace_end(disp, trace, "convert", "pixels", area);
+    set_window(disp, x1, y1, x2, y2);
+    dat_bytes(disp, disp->tmpbuf, (size_t)((x2 - x1 + 1) * (y2 - y1 + 1)) * 2);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
 void st7735_set_buffered(st7735_t *disp, bool enabled) {
-    if (enabled && !disp->buffer) {
-        disp->buffer = malloc(disp->width * disp->height * sizeof(uint16_t));
-        if (!disp->buffer) {
+    if (enabled && !disp->screen.pixels && !disp->indexed) {
+        disp->screen.pixels = malloc(disp->width * disp->height * sizeof(uint16_t));
+        if (!disp->screen.pixels) {
             perror("malloc");
             return;
         }
-        memset(disp->buffer, 0, disp->width * disp->height * sizeof(uint16_t));
-    } else if (!enabled && disp->buffer) {
-        free(disp->buffer);
-        disp->buffer = NULL;
+        memset(disp->screen.pixels, 0, disp->width * disp->height * sizeof(uint16_t));
+    } else if (!enabled && disp->screen.pixels) {
+        free(disp->screen.pixels);
+        disp->screen.pixels = NULL;
+        disp->saves_count = 0;
+        disp->saved_used = 0;
+    } else if (!enabled && disp->indexed) {
+        free(disp->indexed->pixels);
+        free(disp->indexed);
+        disp->indexed = NULL;
     }
 }
 
 bool st7735_is_buffered(const st7735_t *disp) {
-    return disp->buffer != NULL;
+    return disp->screen.pixels || disp->indexed;
+}
+
+int st7735_set_word16(st7735_t *disp, bool enabled) {
+    if (enabled && !disp->spi->word16)
+        return -1;
+    disp->word16 = enabled;
+    return 0;
+}
+
+bool st7735_is_word16(const st7735_t *disp) {
+    return disp->word16;
+}
+
+int st7735_set_color_depth(st7735_t *disp, int bits) {
+    if (bits != 12 && bits != 16)
+        return -1;
+    disp->rgb444 = bits == 12;
+    cmd(disp, ST7735_COLMOD);
+    dat(disp, disp->rgb444 ? 0x03 : 0x05);
+    return 0;
+}
+
+int st7735_color_depth(const st7735_t *disp) {
+    return disp->rgb444 ? 12 : 16;
+}
+
+void st7735_set_speed(st7735_t *disp, uint32_t speed_hz, uint32_t cmd_speed_hz) {
+    disp->speed_hz = speed_hz ? speed_hz : ST7735_SPEED_DEFAULT;
+    disp->cmd_speed_hz = cmd_speed_hz ? cmd_speed_hz : ST7735_CMD_SPEED_DEFAULT;
+}
+
+uint32_t st7735_speed(const st7735_t *disp) {
+    return disp->speed_hz;
+}
+
+/* Each candidate resends the whole framebuffer; throughput comes from the transport counters, so it is the bus rate
+ * actually achieved (the controller rounds the clock down to a divider, and caps it at its own maximum) rather than
+ * the CPU time spent preparing the data */
+int st7735_probe_speeds(st7735_t *disp, const uint32_t *speeds, int count, int frames, st7735_speed_probe_t *results) {
+    if (!speeds || !results || count <= 0 || frames <= 0 || !st7735_is_buffered(disp))
+        return -1;
+    const uint32_t saved = disp->speed_hz;
+    for (int i = 0; i < count; i++) {
+        st7735_set_speed(disp, speeds[i], disp->cmd_speed_hz);
+        spi_counters_t before, after;
+        spi_counters(disp->spi, &before);
+        for (int f = 0; f < frames; f++) {
+            st7735_invalidate(disp, 0, 0, disp->width, disp->height);
+            flush_now(disp);
+        }
+        spi_counters(disp->spi, &after);
+        const uint64_t bytes = after.bytes - before.bytes, nsec = after.nsec - before.nsec;
+        results[i].speed_hz = disp->speed_hz;
+        results[i].bytes_per_sec = nsec ? (uint32_t)(bytes * 1000000000ULL / nsec) : 0;
+        results[i].usec_per_frame = (uint32_t)(nsec / 1000 / (uint64_t)frames);
+    }
+    disp->speed_hz = saved;
+    return count;
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
 
-void st7735_flush(st7735_t *disp) {
-    if (!disp->buffer || !disp->dirty)
+static void flush_send(st7735_t *disp) {
+    if (disp->indexed && disp->dirty) {
+        indexed_flush(disp, disp->dirty_x1, disp->dirty_y1, disp->dirty_x2, disp->dirty_y2);
+        disp->dirty = false;
+    }
+    if (!disp->screen.pixels || !disp->dirty)
         return;
     const int x1 = disp->dirty_x1, y1 = disp->dirty_y1;
     const int x2 = disp->dirty_x2, y2 = disp->dirty_y2;
     const int w = x2 - x1 + 1, h = y2 - y1 + 1;
     set_window(disp, x1, y1, x2, y2);
-    uint8_t *tmp = disp->tmpbuf;
-#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
-    for (int y = y1; y <= y2; y++) {
-        memcpy(tmp, &disp->buffer[y * disp->width + x1], w * 2);
-        tmp += w * 2;
+    if (disp->rgb444) {
+        /* packed straight from the framebuffer when the window spans whole rows, else from rows gathered in tmpbuf */
+        const uint64_t trace = trace_begin(disp);
+        const uint16_t *px = &disp->screen.pixels[y1 * disp->screen.stride + x1];
+        if (w != disp->screen.stride) {
+            uint16_t *rows = (uint16_t *)(void *)disp->tmpbuf;
+            for (int y = y1; y <= y2; y++, rows += w)
+                memcpy(rows, &disp->screen.pixels[y * disp->screen.stride + x1], (size_t)w * sizeof(uint16_t));
+            px = (const uint16_t *)(const void *)disp->tmpbuf;
+        }
+        const size_t len = rgb444_pack(disp->tmpbuf, px, (size_t)(w * h));
+        trace_end(disp, trace, "convert", "pixels", (uint32_t)(w * h));
+        dat_bytes(disp, disp->tmpbuf, len);
+        disp->dirty = false;
+        return;
     }
-    dat_buf(disp, disp->tmpbuf, (size_t)(w * h) * 2);
-#else
+    if (pixels_native(disp)) {
+        /* transfers point at the framebuffer rows, one segment when the window spans whole rows */
+        struct iovec iov[ST7735_HEIGHT];
+        const int segments = w == disp->screen.stride ? 1 : h;
+        for (int i = 0; i < segments; i++) {
+            iov[i].iov_base = &disp->screen.pixels[(y1 + i) * disp->screen.stride + x1];
+            iov[i].iov_len = (size_t)(segments == 1 ? w * h : w) * 2;
+        }
+        dat_pixels(disp, iov, segments);
+        disp->dirty = false;
+        return;
+    }
+    const uint64_t trace = trace_begin(disp);
+    uint8_t *tmp = disp->tmpbuf;
     for (int y = y1; y <= y2; y++)
         for (int x = x1; x <= x2; x++) {
-            const uint16_t px = disp->buffer[y * disp->width + x];
+            const uint16_t px = disp->screen.pixels[y * disp->screen.stride + x];
             *tmp++ = (uint8_t)(px >> 8);
             *tmp++ = (uint8_t)(px & 0xFF);
         }
-    dat_buf(disp, disp->tmpbuf, (size_t)(w * h) * 2);
-#endif
+    trace_end(disp, trace, "convert", "pixels", (uint32_t)(w * h));
+    dat_bytes(disp, disp->tmpbuf, (size_t)(w * h) * 2);
     disp->dirty = false;
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
 
-void st7735_pixel(st7735_t *disp, int x, int y, uint16_t color) {
-    if (x < 0 || x >= disp->width || y < 0 || y >= disp->height)
-        return;
-    if (disp->buffer) {
-        disp->buffer[y * disp->width + x] = color;
-        if (!disp->dirty) {
-            disp->dirty_x1 = disp->dirty_x2 = x;
-            disp->dirty_y1 = disp->dirty_y2 = y;
-            disp->dirty = true;
-        } else {
-            if (x < disp->dirty_x1)
-                disp->dirty_x1 = x;
-            if (x > disp->dirty_x2)
-                disp->dirty_x2 = x;
-            if (y < disp->dirty_y1)
-                disp->dirty_y1 = y;
-            if (y > disp->dirty_y2)
-                disp->dirty_y2 = y;
+static inline int latency_bucket(uint32_t us) {
+    if (us < LATENCY_SUB)
+        return (int)us;
+    const int e = 31 - __builtin_clz(us); /* LATENCY_SUB is 2^3 */
+    const int bucket = (e - 2) * LATENCY_SUB + (int)((us >> (e - 3)) & (LATENCY_SUB - 1));
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+static inline uint32_t latency_bucket_max(int bucket) {
+    if (bucket < LATENCY_SUB)
+        return (uint32_t)bucket;
+    const int e = bucket / LATENCY_SUB + 2, sub = bucket % LATENCY_SUB;
+    return ((uint32_t)(LATENCY_SUB + sub + 1) << (e - 3)) - 1;
+}
+
+static void latency_clear(latency_t *l) {
+    for (int b = 0; b < LATENCY_BUCKETS; b++)
+        atomic_store_explicit(&l->buckets[b], 0, memory_order_relaxed);
+    atomic_store_explicit(&l->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&l->total_us, 0, memory_order_relaxed);
+    atomic_store_explicit(&l->min_us, 0, memory_order_relaxed);
+    atomic_store_explicit(&l->max_us, 0, memory_order_relaxed);
+}
+
+static void latency_record(latency_t *l, uint32_t us) {
+    const uint32_t requested = atomic_load_explicit(&l->resets_requested, memory_order_acquire);
+    if (requested != atomic_load_explicit(&l->resets_done, memory_order_relaxed)) {
+        latency_clear(l);
+        atomic_store_explicit(&l->resets_done, requested, memory_order_release);
+    }
+    const int b = latency_bucket(us);
+    atomic_store_explicit(&l->buckets[b], atomic_load_explicit(&l->buckets[b], memory_order_relaxed) + 1, memory_order_relaxed);
+    const uint64_t count = atomic_load_explicit(&l->count, memory_order_relaxed);
+    if (count == 0 || us < atomic_load_explicit(&l->min_us, memory_order_relaxed))
+        atomic_store_explicit(&l->min_us, us, memory_order_relaxed);
+    if (us > atomic_load_explicit(&l->max_us, memory_order_relaxed))
+        atomic_store_explicit(&l->max_us, us, memory_order_relaxed);
+    counter_add(&l->total_us, us);
+    atomic_store_explicit(&l->count, count + 1, memory_order_relaxed);
+}
+
+/* Upper bound of the bucket holding the given fraction of samples, capped at the true maximum */
+static uint32_t latency_percentile(const latency_t *l, uint64_t count, uint32_t max_us, double fraction) {
+    const uint64_t rank = (uint64_t)ceil((double)count * fraction);
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += atomic_load_explicit(&l->buckets[b], memory_order_relaxed);
+        if (seen >= rank && seen > 0) {
+            const uint32_t bound = latency_bucket_max(b);
+            return bound < max_us ? bound : max_us;
         }
-    } else {
-        const uint8_t buf[2] = { (uint8_t)(color >> 8), (uint8_t)(color & 0xFF) };
-        set_window(disp, x, y, x, y);
-        dat_buf(disp, buf, 2);
     }
+    return max_us;
 }
 
-// ------------------------------------------------------------------------------------------------------------------------
+/* Every transfer of the framebuffer goes through here and is timed, paced or not; the part outside the SPI ioctls is
+ * the CPU cost of conversion (byte swapping, packing, palette expansion) */
+static void flush_now(st7735_t *disp) {
+    if (!disp->dirty || (!disp->indexed && !disp->screen.pixels))
+        return;
+    const uint32_t area = (uint32_t)((disp->dirty_x2 - disp->dirty_x1 + 1) * (disp->dirty_y2 - disp->dirty_y1 + 1));
+    spi_counters_t before, after;
+    spi_counters(disp->spi, &before);
+    const uint64_t trace = trace_begin(disp);
+    const uint64_t start = monotonic_ns();
+    flush_send(disp);
+    const uint64_t elapsed = monotonic_ns() - start;
+    trace_end(disp, trace, "flush", "pixels", area);
+    spi_counters(disp->spi, &after);
+    const uint64_t transfer = after.nsec - before.nsec;
+    counter_add(&disp->counters.flush_transfer_ns, transfer);
+    counter_add(&disp->counters.flush_convert_ns, elapsed > transfer ? elapsed - transfer : 0);
+    const uint64_t us = elapsed / 1000;
+    latency_record(&disp->flush_latency, us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+}
 
-void st7735_fill(st7735_t *disp, uint16_t color) {
-    if (disp->buffer) {
-        for (int y = 0; y < disp->height; y++)
-            for (int x = 0; x < disp->width; x++)
-                st7735_pixel(disp, x, y, color);
-    } else {
-        for (size_t i = 0; i < disp->pixels; i++) {
-            disp->tmpbuf[i * 2] = (uint8_t)(color >> 8);
-            disp->tmpbuf[i * 2 + 1] = (uint8_t)(color & 0xFF);
-        }
-        set_window(disp, 0, 0, disp->width - 1, disp->height - 1);
-        dat_buf(disp, disp->tmpbuf, disp->pixels * 2);
+void st7735_flush_latency(const st7735_t *disp, st7735_latency_t *latency) {
+    const latency_t *l = &disp->flush_latency;
+    if (atomic_load_explicit(&l->resets_done, memory_order_acquire) != atomic_load_explicit(&l->resets_requested, memory_order_relaxed)) {
+        *latency = (st7735_latency_t) { 0 };
+        return;
     }
+    const uint64_t count = atomic_load_explicit(&l->count, memory_order_relaxed);
+    const uint32_t max_us = atomic_load_explicit(&l->max_us, memory_order_relaxed);
+    latency->count = count;
+    latency->min_us = count ? atomic_load_explicit(&l->min_us, memory_order_relaxed) : 0;
+    latency->max_us = max_us;
+    latency->mean_us = count ? (uint32_t)(atomic_load_explicit(&l->total_us, memory_order_relaxed) / count) : 0;
+    latency->p50_us = count ? latency_percentile(l, count, max_us, 0.50) : 0;
+    latency->p99_us = count ? latency_percentile(l, count, max_us, 0.99) : 0;
+}
+
+/* A reset racing a read can leave the baseline ahead of the value read: that reads as zero, never as a wrap */
+static inline uint64_t counter_since(const _Atomic uint64_t *counter, const _Atomic uint64_t *base) {
+    const uint64_t value = atomic_load_explicit(counter, memory_order_relaxed);
+    const uint64_t from = atomic_load_explicit(base, memory_order_relaxed);
+    return value > from ? value - from : 0;
+}
+static inline void counter_mark(_Atomic uint64_t *base, uint64_t value) {
+    atomic_store_explicit(base, value, memory_order_relaxed);
+}
+
+static void counters_copy(counters_t *to, const counters_t *from) {
+    counter_mark(&to->commands, atomic_load_explicit(&from->commands, memory_order_relaxed));
+    counter_mark(&to->windows, atomic_load_explicit(&from->windows, memory_order_relaxed));
+    counter_mark(&to->pixels, atomic_load_explicit(&from->pixels, memory_order_relaxed));
+    counter_mark(&to->pixel_calls, atomic_load_explicit(&from->pixel_calls, memory_order_relaxed));
+    counter_mark(&to->flushes, atomic_load_explicit(&from->flushes, memory_order_relaxed));
+    counter_mark(&to->flush_convert_ns, atomic_load_explicit(&from->flush_convert_ns, memory_order_relaxed));
+    counter_mark(&to->flush_transfer_ns, atomic_load_explicit(&from->flush_transfer_ns, memory_order_relaxed));
+    counter_mark(&to->spi_bytes, atomic_load_explicit(&from->spi_bytes, memory_order_relaxed));
+    counter_mark(&to->spi_nsec, atomic_load_explicit(&from->spi_nsec, memory_order_relaxed));
+    counter_mark(&to->spi_messages, atomic_load_explicit(&from->spi_messages, memory_order_relaxed));
+}
+
+/* The baseline as one consistent set: retried while a reset is writing it or one finished meanwhile */
+static void counters_base_read(const st7735_t *disp, counters_t *base) {
+    uint32_t seq;
+    do {
+        seq = atomic_load_explicit(&disp->counters_seq, memory_order_acquire);
+        counters_copy(base, &disp->counters_base);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&disp->counters_seq, memory_order_relaxed));
+}
+
+/* The live values go first: a reset after them then only makes a count read as zero */
+void st7735_stats_get(const st7735_t *disp, st7735_stats_t *stats) {
+    counters_t now, base;
+    spi_counters_t spi;
+    counters_copy(&now, &disp->counters);
+    spi_counters(disp->spi, &spi);
+    counter_mark(&now.spi_messages, spi.messages);
+    counter_mark(&now.spi_bytes, spi.bytes);
+    counter_mark(&now.spi_nsec, spi.nsec);
+    counters_base_read(disp, &base);
+    stats->ioctls = counter_since(&now.spi_messages, &base.spi_messages);
+    stats->bytes = counter_since(&now.spi_bytes, &base.spi_bytes);
+    stats->transfer_us = counter_since(&now.spi_nsec, &base.spi_nsec) / 1000;
+    stats->commands = counter_since(&now.commands, &base.commands);
+    stats->windows = counter_since(&now.windows, &base.windows);
+    stats->pixels = counter_since(&now.pixels, &base.pixels);
+    stats->pixel_calls = counter_since(&now.pixel_calls, &base.pixel_calls);
+    stats->flushes = counter_since(&now.flushes, &base.flushes);
+    stats->flush_convert_us = counter_since(&now.flush_convert_ns, &base.flush_convert_ns) / 1000;
+    stats->flush_transfer_us = counter_since(&now.flush_transfer_ns, &base.flush_transfer_ns) / 1000;
+    st7735_flush_latency(disp, &stats->flush_latency);
+}
+
+/* Only the baseline and the histogram's reset request are written, so this is safe beside the drawing thread; resets
+ * from several threads take turns on the sequence count */
+void st7735_stats_reset(st7735_t *disp) {
+    uint32_t seq = atomic_load_explicit(&disp->counters_seq, memory_order_relaxed);
+    do {
+        while (seq & 1)
+            seq = atomic_load_explicit(&disp->counters_seq, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&disp->counters_seq, &seq, seq + 1, memory_order_acquire, memory_order_relaxed));
+    atomic_thread_fence(memory_order_release);
+    spi_counters_t spi;
+    spi_counters(disp->spi, &spi);
+    counters_copy(&disp->counters_base, &disp->counters);
+    counter_mark(&disp->counters_base.spi_messages, spi.messages);
+    counter_mark(&disp->counters_base.spi_bytes, spi.bytes);
+    counter_mark(&disp->counters_base.spi_nsec, spi.nsec);
+    atomic_store_explicit(&disp->counters_seq, seq + 2, memory_order_release);
+    st7735_flush_latency_reset(disp);
+}
+
+void st7735_flush_latency_reset(st7735_t *disp) {
+    atomic_fetch_add_explicit(&disp->flush_latency.resets_requested, 1, memory_order_release);
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
 
-void st7735_line(st7735_t *disp, int x0, int y0, int x1, int y1, uint16_t color) {
-    const int dx = abs(x1 - x0), dy = abs(y1 - y0);
-    const int sx = (x0 < x1) ? 1 : -1, sy = (y0 < y1) ? 1 : -1;
-    int e = dx - dy;
-    while (1) {
-        st7735_pixel(disp, x0, y0, color);
-        if (x0 == x1 && y0 == y1)
-            break;
-        const int e2 = 2 * e;
-        if (e2 > -dy) {
-            e -= dy;
-            x0 += sx;
+int st7735_trace_start(st7735_t *disp, int capacity) {
+    if (capacity <= 0)
+        return -1;
+    if (!disp->trace || disp->trace->capacity != (uint32_t)capacity) {
+        trace_t *t = disp->trace ? disp->trace : calloc(1, sizeof(trace_t));
+        if (!t) {
+            perror("calloc");
+            return -1;
         }
-        if (e2 < dx) {
-            e += dx;
-            y0 += sy;
+        trace_event_t *events = malloc((size_t)capacity * sizeof(trace_event_t));
+        if (!events) {
+            perror("malloc");
+            if (!disp->trace)
+                free(t);
+            return -1;
         }
+        free(t->events);
+        t->events = events;
+        t->capacity = (uint32_t)capacity;
+        disp->trace = t;
+    }
+    disp->trace->recorded = 0;
+    disp->trace->recording = true;
+    return 0;
+}
+
+void st7735_trace_stop(st7735_t *disp) {
+    if (disp->trace)
+        disp->trace->recording = false;
+}
+
+uint64_t st7735_trace_begin(const st7735_t *disp) {
+    return trace_begin(disp);
+}
+void st7735_trace_end(st7735_t *disp, uint64_t begin, const char *name) {
+    trace_end(disp, begin, name ? name : "?", NULL, 0);
+}
+
+static void trace_json_string(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++)
+        if (*s == '"' || *s == '\\')
+            fprintf(fp, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(fp, "\\u%04x", (unsigned)*s);
+        else
+            fputc(*s, fp);
+    fputc('"', fp);
+}
+
+/* Chrome trace event format: one complete ("X") event per stage, timestamps in microseconds of CLOCK_MONOTONIC so
+ * that the traces of several displays line up */
+int st7735_trace_dump(const st7735_t *disp, const char *path) {
+    const trace_t *t = disp->trace;
+    if (!t)
+        return -1;
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror("fopen");
+        return -1;
+    }
+    const uint64_t count = t->recorded < t->capacity ? t->recorded : t->capacity;
+    fputs("{\"traceEvents\":[\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"st7735\"}}", fp);
+    for (uint64_t i = t->recorded - count; i < t->recorded; i++) {
+        const trace_event_t *e = &t->events[i % t->capacity];
+        fputs(",\n{\"name\":", fp);
+        trace_json_string(fp, e->name);
+        fprintf(fp, ",\"cat\":\"st7735\",\"ph\":\"X\",\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":1,\"tid\":1",
+                (unsigned long long)(e->start_ns / 1000), (unsigned)(e->start_ns % 1000), (unsigned long long)(e->dur_ns / 1000),
+                (unsigned)(e->dur_ns % 1000));
+        if (e->arg_name)
+            fprintf(fp, ",\"args\":{\"%s\":%u}", e->arg_name, e->arg);
+        fputc('}', fp);
     }
+    fputs("\n],\"displayTimeUnit\":\"ns\"}\n", fp);
+    if (fclose(fp) != 0) {
+        perror("fclose");
+        return -1;
+    }
+    return (int)count;
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
 
-void st7735_rect(st7735_t *disp, int x, int y, int w, int h, uint16_t color) {
-    st7735_line(disp, x, y, x + w - 1, y, color);                 /* top */
-    st7735_line(disp, x, y + h - 1, x + w - 1, y + h - 1, color); /* bottom */
-    st7735_line(disp, x, y, x, y + h - 1, color);                 /* left */
-    st7735_line(disp, x + w - 1, y, x + w - 1, y + h - 1, color); /* right */
+#define REALTIME_STACK (64 * 1024) /* stack prefaulted for the flushing thread */
+
+static void __attribute__((noinline)) realtime_prefault_stack(void) {
+    volatile uint8_t stack[REALTIME_STACK];
+    for (size_t i = 0; i < sizeof(stack); i += 4096)
+        stack[i] = 0;
 }
 
-void st7735_fill_rect(st7735_t *disp, int x, int y, int w, int h, uint16_t color) {
-    if (disp->buffer) {
-        for (int py = y; py < y + h; py++)
-            for (int px = x; px < x + w; px++)
-                st7735_pixel(disp, px, py, color);
-    } else {
-        for (size_t i = 0; i < (size_t)(w * h); i++) {
-            disp->tmpbuf[i * 2] = (uint8_t)(color >> 8);
-            disp->tmpbuf[i * 2 + 1] = (uint8_t)(color & 0xFF);
+/* Settings applied before a failure stay applied; locked tells whether mlockall was one of them */
+static int realtime_apply(pthread_t thread, const st7735_realtime_t *rt, bool *locked) {
+    if (rt->lock_memory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+            perror("mlockall");
+            return -1;
+        }
+        *locked = true;
+    }
+    if (rt->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET((size_t)rt->cpu, &set);
+        const int err = pthread_setaffinity_np(thread, sizeof(set), &set);
+        if (err != 0) {
+            errno = err;
+            perror("pthread_setaffinity_np");
+            return -1;
+        }
+    }
+    if (rt->priority > 0) {
+        const struct sched_param param = { .sched_priority = rt->priority };
+        const int err = pthread_setschedparam(thread, SCHED_FIFO, &param);
+        if (err != 0) {
+            errno = err;
+            perror("pthread_setschedparam");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* The first call after a clear saves the thread's settings, so repeated calls still restore what was there before */
+int st7735_set_realtime(st7735_t *disp, const st7735_realtime_t *rt) {
+    realtime_saved_t *saved = &disp->realtime_saved;
+    if (!saved->saved) {
+        int err = pthread_getschedparam(pthread_self(), &saved->policy, &saved->param);
+        if (err != 0) {
+            errno = err;
+            perror("pthread_getschedparam");
+            return -1;
+        }
+        err = pthread_getaffinity_np(pthread_self(), sizeof(saved->affinity), &saved->affinity);
+        if (err != 0) {
+            errno = err;
+            perror("pthread_getaffinity_np");
+            return -1;
         }
-        set_window(disp, x, y, x + w - 1, y + h - 1);
-        dat_buf(disp, disp->tmpbuf, (size_t)(w * h) * 2);
+        saved->saved = true;
+        saved->locked = false;
+    }
+    if (rt->lock_memory)
+        realtime_prefault_stack();
+    const int result = realtime_apply(pthread_self(), rt, &saved->locked);
+    st7735_flush_latency_reset(disp);
+    return result;
+}
+
+/* Puts back the policy, priority and CPU mask saved by st7735_set_realtime; memory is unlocked only if it locked it */
+int st7735_clear_realtime(st7735_t *disp) {
+    realtime_saved_t *saved = &disp->realtime_saved;
+    if (!saved->saved)
+        return 0;
+    int result = 0;
+    int err = pthread_setschedparam(pthread_self(), saved->policy, &saved->param);
+    if (err != 0) {
+        errno = err;
+        perror("pthread_setschedparam");
+        result = -1;
+    }
+    err = pthread_setaffinity_np(pthread_self(), sizeof(saved->affinity), &saved->affinity);
+    if (err != 0) {
+        errno = err;
+        perror("pthread_setaffinity_np");
+        result = -1;
+    }
+    if (saved->locked && munlockall() < 0) {
+        perror("munlockall");
+        result = -1;
     }
+    saved->saved = false;
+    st7735_flush_latency_reset(disp);
+    return result;
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
 
-void st7735_circle(st7735_t *disp, int x0, int y0, int r, uint16_t color) {
-    int x = r, y = 0;
-    int e = 0;
-    while (x >= y) {
-        st7735_pixel(disp, x0 + x, y0 + y, color);
-        st7735_pixel(disp, x0 + y, y0 + x, color);
-        st7735_pixel(disp, x0 - y, y0 + x, color);
-        st7735_pixel(disp, x0 - x, y0 + y, color);
-        st7735_pixel(disp, x0 - x, y0 - y, color);
-        st7735_pixel(disp, x0 - y, y0 - x, color);
-        st7735_pixel(disp, x0 + y, y0 - x, color);
-        st7735_pixel(disp, x0 + x, y0 - y, color);
-        e += 1 + 2 * (++y);
-        if (2 * (e - x) + 1 > 0)
-            e += 1 - 2 * (--x);
+/* Paced: a flush before the deadline only leaves the region dirty, so every update within a period goes out together
+ * with the first flush (or st7735_frame) after it; there is no timer, the caller ends a burst with st7735_frame */
+void st7735_flush(st7735_t *disp) {
+    counter_add(&disp->counters.flushes, 1);
+    if (disp->frame_period_ns && disp->dirty) {
+        const uint64_t now = monotonic_ns();
+        if (now < disp->frame_next_ns) {
+            disp->frame_stats.coalesced++;
+            return;
+        }
+        disp->frame_next_ns = now - disp->frame_next_ns < disp->frame_period_ns ? disp->frame_next_ns + disp->frame_period_ns
+                                                                               : now + disp->frame_period_ns;
+        disp->frame_stats.frames++;
     }
+    flush_now(disp);
 }
 
-void st7735_fill_circle(st7735_t *disp, int x0, int y0, int r, uint16_t color) {
-    int x = r, y = 0;
-    int e = 0;
-    while (x >= y) {
-        st7735_line(disp, x0 - x, y0 + y, x0 + x, y0 + y, color);
-        st7735_line(disp, x0 - y, y0 + x, x0 + y, y0 + x, color);
-        st7735_line(disp, x0 - x, y0 - y, x0 + x, y0 - y, color);
-        st7735_line(disp, x0 - y, y0 - x, x0 + y, y0 - x, color);
-        e += 1 + 2 * (++y);
-        if (2 * (e - x) + 1 > 0)
-            e += 1 - 2 * (--x);
+bool st7735_frame_pending(const st7735_t *disp) {
+    return disp->frame_period_ns && disp->dirty;
+}
+
+static inline struct timespec frame_deadline(const st7735_t *disp) {
+    return (struct timespec) { (time_t)(disp->frame_next_ns / 1000000000ULL), (long)(disp->frame_next_ns % 1000000000ULL) };
+}
+static void frame_sleep(const st7735_t *disp) {
+    const struct timespec deadline = frame_deadline(disp);
+    const uint64_t trace = trace_begin(disp);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+        ;
+    trace_end(disp, trace, "pace", NULL, 0);
+}
+
+int st7735_frame(st7735_t *disp) {
+    if (!disp->frame_period_ns) {
+        flush_now(disp);
+        return 0;
+    }
+    uint64_t now = monotonic_ns();
+    int missed = 0;
+    if (now < disp->frame_next_ns) {
+        frame_sleep(disp);
+        now = monotonic_ns();
+    } else if (now - disp->frame_next_ns >= disp->frame_period_ns) {
+        /* whole periods went by without a frame: count them and pick up the cadence from the latest one */
+        const uint64_t periods = (now - disp->frame_next_ns) / disp->frame_period_ns;
+        missed = periods > INT_MAX ? INT_MAX : (int)periods;
+        disp->frame_stats.missed += periods;
+        disp->frame_next_ns += periods * disp->frame_period_ns;
+    }
+    const uint32_t late_us = (uint32_t)((now - disp->frame_next_ns) / 1000);
+    if (late_us > disp->frame_stats.late_max_us)
+        disp->frame_stats.late_max_us = late_us;
+    flush_now(disp);
+    const uint32_t flush_us = (uint32_t)((monotonic_ns() - now) / 1000);
+    if (flush_us > disp->frame_stats.flush_max_us)
+        disp->frame_stats.flush_max_us = flush_us;
+    disp->frame_stats.frames++;
+    disp->frame_next_ns += disp->frame_period_ns;
+    return missed;
+}
+
+/* Normal mode frame rate = fosc / ((RTNA * 2 + 40) * (LINE + FPA + BPA + 2)), RTNA 0-15, porches 1-63 lines each.
+ * Picks the multiple of fps nearest the 80 Hz power-on rate that the panel can reach, so updates land at a fixed
+ * phase of its refresh, and returns the rate achieved in centihertz. */
+static int panel_frame_rate(st7735_t *disp, int fps) {
+    int multiple = (80 + fps / 2) / fps;
+    if (multiple < 1)
+        multiple = 1;
+    const int64_t target = (int64_t)fps * multiple;
+    int64_t best_error = INT64_MAX;
+    int rtna = 1, porches = 0x2C + 0x2D;
+    for (int r = 0; r <= 15; r++)
+        for (int p = 2; p <= 126; p++) {
+            const int64_t error = llabs((int64_t)ST7735_FOSC - target * (r * 2 + 40) * (ST7735_HEIGHT + p + 2));
+            if (error < best_error) {
+                best_error = error;
+                rtna = r;
+                porches = p;
+            }
+        }
+    cmd(disp, ST7735_FRMCTR1);
+    dat(disp, (uint8_t)rtna);
+    dat(disp, (uint8_t)(porches / 2));
+    dat(disp, (uint8_t)(porches - porches / 2));
+    return (int)((int64_t)ST7735_FOSC * 100 / ((rtna * 2 + 40) * (ST7735_HEIGHT + porches + 2)));
+}
+
+int st7735_set_frame_rate(st7735_t *disp, int fps, bool panel) {
+    if (fps < 0 || fps > 1000)
+        return -1;
+    disp->frame_period_ns = fps ? (uint64_t)1000000000 / (uint64_t)fps : 0;
+    disp->frame_next_ns = monotonic_ns();
+    disp->frame_stats = (st7735_frame_stats_t) { .fps = fps, .panel_centihz = disp->frame_stats.panel_centihz };
+    if (panel && fps)
+        disp->frame_stats.panel_centihz = panel_frame_rate(disp, fps);
+    else if (panel) {
+        cmd(disp, ST7735_FRMCTR1); /* power-on setting from init_seq */
+        dat(disp, 0x01);
+        dat(disp, 0x2C);
+        dat(disp, 0x2D);
+        disp->frame_stats.panel_centihz = 0;
     }
+    if (!fps)
+        flush_now(disp);
+    return 0;
+}
+
+void st7735_frame_stats(const st7735_t *disp, st7735_frame_stats_t *stats) {
+    *stats = disp->frame_stats;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+static inline void dirty_mark(st7735_t *disp, int x1, int y1, int x2, int y2) {
+    if (!disp->dirty) {
+        disp->dirty_x1 = x1;
+        disp->dirty_y1 = y1;
+        disp->dirty_x2 = x2;
+        disp->dirty_y2 = y2;
+        disp->dirty = true;
+    } else {
+        if (x1 < disp->dirty_x1)
+            disp->dirty_x1 = x1;
+        if (x2 > disp->dirty_x2)
+            disp->dirty_x2 = x2;
+        if (y1 < disp->dirty_y1)
+            disp->dirty_y1 = y1;
+        if (y2 > disp->dirty_y2)
+            disp->dirty_y2 = y2;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+/* Drawing target shared by the display and offscreen surface functions. The display canvas is its framebuffer
+ * surface, whose pixels are NULL when unbuffered: then writes go straight to the panel. Coordinates passed to the
+ * drawing routines are relative to the origin; the clip and everything below canvas_place are surface coordinates. */
+typedef struct {
+    st7735_surface_t *surface;
+    st7735_t *disp;                             /* panel writes and damage tracking, NULL offscreen */
+    int clip_x1, clip_y1, clip_x2, clip_y2;     /* drawable area, end exclusive, within the surface */
+    int org_x, org_y;                           /* origin of drawing coordinates within the surface */
+} canvas_t;
+
+static inline canvas_t display_canvas(st7735_t *disp) {
+    return (canvas_t) { &disp->screen, disp, 0, 0, disp->screen.width, disp->screen.height, 0, 0 };
+}
+static inline canvas_t surface_canvas(st7735_surface_t *surface) {
+    return (canvas_t) { surface, NULL, 0, 0, surface->width, surface->height, 0, 0 };
+}
+/* The display as seen by the public drawing calls: the top of the clip / viewport stack */
+static inline canvas_t view_canvas(st7735_t *disp) {
+    canvas_t c = display_canvas(disp);
+    if (disp->views_count > 0) {
+        const view_t *v = &disp->views[disp->views_count - 1];
+        c.clip_x1 = v->x1, c.clip_y1 = v->y1, c.clip_x2 = v->x2, c.clip_y2 = v->y2;
+        c.org_x = v->org_x, c.org_y = v->org_y;
+    }
+    return c;
+}
+
+/* Narrow the drawable area to x1,y1..x2,y2 inclusive */
+static inline void canvas_restrict(canvas_t *c, int x1, int y1, int x2, int y2) {
+    if (x1 > c->clip_x1)
+        c->clip_x1 = x1;
+    if (y1 > c->clip_y1)
+        c->clip_y1 = y1;
+    if (x2 + 1 < c->clip_x2)
+        c->clip_x2 = x2 + 1;
+    if (y2 + 1 < c->clip_y2)
+        c->clip_y2 = y2 + 1;
+}
+
+/* Drawing coordinates to surface coordinates */
+static inline void canvas_place(const canvas_t *c, int *x, int *y) {
+    *x += c->org_x;
+    *y += c->org_y;
+}
+
+/* Whether x1,y1..x2,y2 inclusive, in drawing coordinates, touches the drawable area: lets a primitive that is
+ * entirely clipped return before walking any pixels */
+static inline bool canvas_visible(const canvas_t *c, int x1, int y1, int x2, int y2) {
+    return x2 + c->org_x >= c->clip_x1 && x1 + c->org_x < c->clip_x2 && y2 + c->org_y >= c->clip_y1 && y1 + c->org_y < c->clip_y2;
+}
+
+/* Clip x,y,w,h in surface coordinates to the canvas; returns false if nothing is visible */
+static inline bool canvas_clip(const canvas_t *c, int *x, int *y, int *w, int *h) {
+    int x2 = *x + *w, y2 = *y + *h;
+    if (*x < c->clip_x1)
+        *x = c->clip_x1;
+    if (*y < c->clip_y1)
+        *y = c->clip_y1;
+    if (x2 > c->clip_x2)
+        x2 = c->clip_x2;
+    if (y2 > c->clip_y2)
+        y2 = c->clip_y2;
+    *w = x2 - *x;
+    *h = y2 - *y;
+    return *w > 0 && *h > 0;
+}
+
+static inline void canvas_pixel(const canvas_t *c, int x, int y, uint16_t color) {
+    st7735_surface_t *s = c->surface;
+    canvas_place(c, &x, &y);
+    if (x < c->clip_x1 || x >= c->clip_x2 || y < c->clip_y1 || y >= c->clip_y2)
+        return;
+    if (s->pixels) {
+        s->pixels[y * s->stride + x] = color;
+        if (c->disp)
+            dirty_mark(c->disp, x, y, x, y);
+    } else if (c->disp->indexed) {
+        indexed_set(c->disp->indexed, x, y, indexed_match(c->disp->indexed, color));
+        dirty_mark(c->disp, x, y, x, y);
+    } else {
+        uint8_t buf[2] = { (uint8_t)(color >> 8), (uint8_t)(color & 0xFF) };
+        if (c->disp->rgb444)
+            rgb444_pack(buf, &color, 1);
+        set_window(c->disp, x, y, x, y);
+        dat_bytes(c->disp, buf, 2);
+    }
+}
+
+/* Solid block in surface coordinates */
+static void canvas_fill(const canvas_t *c, int x, int y, int w, int h, uint16_t color) {
+    if (!canvas_clip(c, &x, &y, &w, &h))
+        return;
+    st7735_surface_t *s = c->surface;
+    if (s->pixels) {
+        for (int py = y; py < y + h; py++) {
+            uint16_t *row = s->pixels + py * s->stride + x;
+            for (int px = 0; px < w; px++)
+                row[px] = color;
+        }
+        if (c->disp)
+            dirty_mark(c->disp, x, y, x + w - 1, y + h - 1);
+    } else if (c->disp->indexed) {
+        indexed_fill(c->disp->indexed, x, y, w, h, color);
+        dirty_mark(c->disp, x, y, x + w - 1, y + h - 1);
+    } else {
+        uint16_t *px = (uint16_t *)(void *)c->disp->tmpbuf;
+        for (size_t i = 0; i < (size_t)(w * h); i++)
+            px[i] = color;
+        set_window(c->disp, x, y, x + w - 1, y + h - 1);
+        dat_staged(c->disp, (size_t)(w * h));
+    }
+}
+static inline void canvas_rect(const canvas_t *c, int x, int y, int w, int h, uint16_t color) {
+    canvas_place(c, &x, &y);
+    canvas_fill(c, x, y, w, h, color);
+}
+
+/* Destination rows for a clipped block: surface rows, else staging rows in tmpbuf that canvas_rows_done sends to the
+ * panel or stores as palette indices */
+static inline uint16_t *canvas_row(const canvas_t *c, int x, int y, int w, int row) {
+    st7735_surface_t *s = c->surface;
+    if (s->pixels)
+        return s->pixels + (y + row) * s->stride + x;
+    return (uint16_t *)(void *)c->disp->tmpbuf + row * w;
+}
+static void canvas_rows_done(const canvas_t *c, int x, int y, int w, int h) {
+    if (c->surface->pixels) {
+        if (c->disp)
+            dirty_mark(c->disp, x, y, x + w - 1, y + h - 1);
+        return;
+    }
+    if (c->disp->indexed) {
+        indexed_store(c->disp->indexed, (const uint16_t *)(const void *)c->disp->tmpbuf, x, y, w, h);
+        dirty_mark(c->disp, x, y, x + w - 1, y + h - 1);
+        return;
+    }
+    set_window(c->disp, x, y, x + w - 1, y + h - 1);
+    dat_staged(c->disp, (size_t)(w * h));
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------
+
+st7735_surface_t *st7735_surface_create(int width, int height) {
+    if (width <= 0 || height <= 0)
+        return NULL;
+    /* single allocation: pixels follow the header */
+    st7735_surface_t *surface = malloc(sizeof(st7735_surface_t) + (size_t)width * (size_t)height * sizeof(uint16_t));
+    if (!surface) {
+        perror("malloc");
+        return NULL;
+    }
+    st7735_surface_init(surface, (uint16_t *)(void *)(surface + 1), width, height, width);
+    memset(surface->pixels, 0, (size_t)width * (size_t)height * sizeof(uint16_t));
+    return surface;
+}
+
+void st7735_surface_init(st7735_surface_t *surface, uint16_t *pixels, int width, int height, int stride) {
+    surface->pixels = pixels;
+    surface->width = width;
+    surface->height = height;
+    surface->stride = stride;
+}
+
+void st7735_surface_destroy(st7735_surface_t *surface) {
+    free(surface);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+st7735_surface_t *st7735_framebuffer(st7735_t *disp) {
+    return disp->screen.pixels ? &disp->screen : NULL;
+}
+
+void st7735_invalidate(st7735_t *disp, int x, int y, int w, int h) {
+    const canvas_t c = display_canvas(disp);
+    if (st7735_is_buffered(disp) && canvas_clip(&c, &x, &y, &w, &h))
+        dirty_mark(disp, x, y, x + w - 1, y + h - 1);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+/* Switching formats carries the picture across (quantised into the palette, or expanded back) and marks it all for
+ * the next flush; from unbuffered the frame starts as index 0 like a fresh RGB565 framebuffer */
+int st7735_set_indexed(st7735_t *disp, int bpp, const uint16_t *palette, int count) {
+    const int width = disp->width, height = disp->height;
+    indexed_t *old = disp->indexed;
+    if (bpp == 0) {
+        if (!old)
+            return 0;
+        uint16_t *pixels = malloc((size_t)width * (size_t)height * sizeof(uint16_t));
+        if (!pixels) {
+            perror("malloc");
+            return -1;
+        }
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++)
+                pixels[y * width + x] = old->colors[indexed_get(old, x, y)];
+        free(old->pixels);
+        free(old);
+        disp->indexed = NULL;
+        disp->screen.pixels = pixels;
+        dirty_mark(disp, 0, 0, width - 1, height - 1);
+        return 0;
+    }
+    if ((bpp != 4 && bpp != 8) || !palette || count < 1 || count > (1 << bpp))
+        return -1;
+    indexed_t *ix = malloc(sizeof(indexed_t));
+    const int stride = bpp == 8 ? width : (width + 1) / 2;
+    uint8_t *pixels = calloc((size_t)stride * (size_t)height, 1);
+    if (!ix || !pixels) {
+        perror("malloc");
+        free(ix);
+        free(pixels);
+        return -1;
+    }
+    ix->pixels = pixels;
+    ix->bpp = bpp;
+    ix->stride = stride;
+    indexed_palette(ix, palette, count);
+    if (disp->screen.pixels || old) {
+        for (int y = 0; y < height; y++)
+            for (int x = 0; x < width; x++) {
+                const uint16_t color = disp->screen.pixels ? disp->screen.pixels[y * disp->screen.stride + x] : old->colors[indexed_get(old, x, y)];
+                indexed_set(ix, x, y, indexed_match(ix, color));
+            }
+        dirty_mark(disp, 0, 0, width - 1, height - 1);
+    }
+    if (old)
+        free(old->pixels);
+    free(old);
+    free(disp->screen.pixels);
+    disp->screen.pixels = NULL;
+    disp->saves_count = 0;
+    disp->saved_used = 0;
+    disp->indexed = ix;
+    return 0;
+}
+
+int st7735_set_palette(st7735_t *disp, const uint16_t *palette, int count) {
+    indexed_t *ix = disp->indexed;
+    if (!ix || !palette || count < 1 || count > (1 << ix->bpp))
+        return -1;
+    indexed_palette(ix, palette, count);
+    dirty_mark(disp, 0, 0, disp->width - 1, disp->height - 1);
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------
+
+void st7735_pixel(st7735_t *disp, int x, int y, uint16_t color) {
+    counter_add(&disp->counters.pixel_calls, 1);
+    const canvas_t c = view_canvas(disp);
+    canvas_pixel(&c, x, y, color);
+}
+void st7735_surface_pixel(st7735_surface_t *surface, int x, int y, uint16_t color) {
+    const canvas_t c = surface_canvas(surface);
+    canvas_pixel(&c, x, y, color);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+void st7735_fill(st7735_t *disp, uint16_t color) {
+    const canvas_t c = view_canvas(disp);
+    canvas_fill(&c, c.clip_x1, c.clip_y1, c.clip_x2 - c.clip_x1, c.clip_y2 - c.clip_y1, color);
+}
+void st7735_surface_fill(st7735_surface_t *surface, uint16_t color) {
+    const canvas_t c = surface_canvas(surface);
+    canvas_rect(&c, 0, 0, surface->width, surface->height, color);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+static void draw_line(const canvas_t *c, int x0, int y0, int x1, int y1, uint16_t color) {
+    if (!canvas_visible(c, x0 < x1 ? x0 : x1, y0 < y1 ? y0 : y1, x0 < x1 ? x1 : x0, y0 < y1 ? y1 : y0))
+        return;
+    if (y0 == y1) {
+        canvas_rect(c, x0 < x1 ? x0 : x1, y0, abs(x1 - x0) + 1, 1, color);
+        return;
+    }
+    if (x0 == x1) {
+        canvas_rect(c, x0, y0 < y1 ? y0 : y1, 1, abs(y1 - y0) + 1, color);
+        return;
+    }
+    const int dx = abs(x1 - x0), dy = abs(y1 - y0);
+    const int sx = (x0 < x1) ? 1 : -1, sy = (y0 < y1) ? 1 : -1;
+    int e = dx - dy;
+    while (1) {
+        canvas_pixel(c, x0, y0, color);
+        if (x0 == x1 && y0 == y1)
+            break;
+        const int e2 = 2 * e;
+        if (e2 > -dy) {
+            e -= dy;
+            x0 += sx;
+        }
+        if (e2 < dx) {
+            e += dx;
+            y0 += sy;
+        }
+    }
+}
+
+void st7735_line(st7735_t *disp, int x0, int y0, int x1, int y1, uint16_t color) {
+    const canvas_t c = view_canvas(disp);
+    draw_line(&c, x0, y0, x1, y1, color);
+}
+void st7735_surface_line(st7735_surface_t *surface, int x0, int y0, int x1, int y1, uint16_t color) {
+    const canvas_t c = surface_canvas(surface);
+    draw_line(&c, x0, y0, x1, y1, color);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+static void draw_rect(const canvas_t *c, int x, int y, int w, int h, uint16_t color) {
+    if (w <= 0 || h <= 0)
+        return;
+    canvas_rect(c, x, y, w, 1, color);         /* top */
+    canvas_rect(c, x, y + h - 1, w, 1, color); /* bottom */
+    canvas_rect(c, x, y, 1, h, color);         /* left */
+    canvas_rect(c, x + w - 1, y, 1, h, color); /* right */
+}
+
+void st7735_rect(st7735_t *disp, int x, int y, int w, int h, uint16_t color) {
+    const canvas_t c = view_canvas(disp);
+    draw_rect(&c, x, y, w, h, color);
+}
+void st7735_surface_rect(st7735_surface_t *surface, int x, int y, int w, int h, uint16_t color) {
+    const canvas_t c = surface_canvas(surface);
+    draw_rect(&c, x, y, w, h, color);
+}
+
+void st7735_fill_rect(st7735_t *disp, int x, int y, int w, int h, uint16_t color) {
+    const canvas_t c = view_canvas(disp);
+    canvas_rect(&c, x, y, w, h, color);
+}
+void st7735_surface_fill_rect(st7735_surface_t *surface, int x, int y, int w, int h, uint16_t color) {
+    const canvas_t c = surface_canvas(surface);
+    canvas_rect(&c, x, y, w, h, color);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+static void draw_circle(const canvas_t *c, int x0, int y0, int r, uint16_t color) {
+    if (!canvas_visible(c, x0 - r, y0 - r, x0 + r, y0 + r))
+        return;
+    int x = r, y = 0;
+    int e = 0;
+    while (x >= y) {
+        canvas_pixel(c, x0 + x, y0 + y, color);
+        canvas_pixel(c, x0 + y, y0 + x, color);
+        canvas_pixel(c, x0 - y, y0 + x, color);
+        canvas_pixel(c, x0 - x, y0 + y, color);
+        canvas_pixel(c, x0 - x, y0 - y, color);
+        canvas_pixel(c, x0 - y, y0 - x, color);
+        canvas_pixel(c, x0 + y, y0 - x, color);
+        canvas_pixel(c, x0 + x, y0 - y, color);
+        e += 1 + 2 * (++y);
+        if (2 * (e - x) + 1 > 0)
+            e += 1 - 2 * (--x);
+    }
+}
+
+static void draw_fill_circle(const canvas_t *c, int x0, int y0, int r, uint16_t color) {
+    if (!canvas_visible(c, x0 - r, y0 - r, x0 + r, y0 + r))
+        return;
+    int x = r, y = 0;
+    int e = 0;
+    while (x >= y) {
+        canvas_rect(c, x0 - x, y0 + y, 2 * x + 1, 1, color);
+        canvas_rect(c, x0 - y, y0 + x, 2 * y + 1, 1, color);
+        canvas_rect(c, x0 - x, y0 - y, 2 * x + 1, 1, color);
+        canvas_rect(c, x0 - y, y0 - x, 2 * y + 1, 1, color);
+        e += 1 + 2 * (++y);
+        if (2 * (e - x) + 1 > 0)
+            e += 1 - 2 * (--x);
+    }
+}
+
+void st7735_circle(st7735_t *disp, int x0, int y0, int r, uint16_t color) {
+    const canvas_t c = view_canvas(disp);
+    draw_circle(&c, x0, y0, r, color);
+}
+void st7735_surface_circle(st7735_surface_t *surface, int x0, int y0, int r, uint16_t color) {
+    const canvas_t c = surface_canvas(surface);
+    draw_circle(&c, x0, y0, r, color);
+}
+
+void st7735_fill_circle(st7735_t *disp, int x0, int y0, int r, uint16_t color) {
+    const canvas_t c = view_canvas(disp);
+    draw_fill_circle(&c, x0, y0, r, color);
+}
+void st7735_surface_fill_circle(st7735_surface_t *surface, int x0, int y0, int r, uint16_t color) {
+    const canvas_t c = surface_canvas(surface);
+    draw_fill_circle(&c, x0, y0, r, color);
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
@@ -564,90 +1784,2405 @@ static const uint8_t font5x7[] = {
     0x08, 0x08, 0x2A, 0x1C, 0x08, /* 126 ~ */
 };
 
-static inline int st7735_char_space(st7735_t *disp, int x, int y, uint16_t bg, int char_height, int spacing) {
-    for (int i = 0; i < spacing; i++, x++)
-        for (int j = 0; j < char_height; j++)
-            st7735_pixel(disp, x, y + j, bg);
-    return spacing;
+/* Render a column-major glyph cell as one block: bit k of byte (i * col_bytes + k / 8) is pixel (i, k) */
+static int draw_glyph(const canvas_t *c, int x, int y, uint16_t fg, uint16_t bg, const uint8_t *cols, int col_bytes, int width, int height) {
+    canvas_place(c, &x, &y);
+    int cx = x, cy = y, w = width, h = height;
+    if (!canvas_clip(c, &cx, &cy, &w, &h))
+        return width;
+    for (int py = 0; py < h; py++) {
+        const int j = cy - y + py;
+        const uint8_t *bits = cols + (cx - x) * col_bytes + j / 8;
+        const uint8_t mask = (uint8_t)(1 << (j % 8));
+        uint16_t *dst = canvas_row(c, cx, cy, w, py);
+        for (int px = 0; px < w; px++, bits += col_bytes)
+            dst[px] = (*bits & mask) ? fg : bg;
+    }
+    canvas_rows_done(c, cx, cy, w, h);
+    return width;
+}
+
+static int draw_char(const canvas_t *c, int x, int y, uint16_t fg, uint16_t bg, char ch) {
+    if (ch < 32 || ch > 126)
+        ch = '?';
+    const int char_height = 7, char_offs = ch - 32, char_width = 5;
+    return draw_glyph(c, x, y, fg, bg, &font5x7[char_offs * char_width], 1, char_width, char_height);
+}
+
+static int draw_text(const canvas_t *c, int x, int y, uint16_t fg, uint16_t bg, int spacing, const char *str) {
+    if (!str)
+        return 0;
+    const int x_start = x;
+    const int char_height = 7;
+    while (*str) {
+        x += draw_char(c, x, y, fg, bg, *str++);
+        canvas_rect(c, x, y, spacing, char_height, bg);
+        x += spacing;
+    }
+    return x - x_start;
+}
+
+int st7735_char(st7735_t *disp, int x, int y, uint16_t fg, uint16_t bg, char c) {
+    const canvas_t cv = view_canvas(disp);
+    return draw_char(&cv, x, y, fg, bg, c);
+}
+int st7735_surface_char(st7735_surface_t *surface, int x, int y, uint16_t fg, uint16_t bg, char c) {
+    const canvas_t cv = surface_canvas(surface);
+    return draw_char(&cv, x, y, fg, bg, c);
+}
+
+int st7735_text(st7735_t *disp, int x, int y, uint16_t fg, uint16_t bg, int spacing, const char *str) {
+    const canvas_t c = view_canvas(disp);
+    return draw_text(&c, x, y, fg, bg, spacing, str);
+}
+int st7735_surface_text(st7735_surface_t *surface, int x, int y, uint16_t fg, uint16_t bg, int spacing, const char *str) {
+    const canvas_t c = surface_canvas(surface);
+    return draw_text(&c, x, y, fg, bg, spacing, str);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+#ifdef ST7735_EXTERNAL_FONTS
+
+static int draw_char_font(const canvas_t *c, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, char ch) {
+    if (!font || !font->data)
+        return 0;
+    if (ch < font->base || ch > font->limit)
+        ch = '?';
+    const int char_height = (font->height + 7) / 8;
+    const int char_offs = ((font->width * char_height) + 1) * (ch - font->base);
+    const int char_width = mono ? font->width : (int)font->data[char_offs];
+    return draw_glyph(c, x, y, fg, bg, &font->data[char_offs + 1], char_height, char_width, font->height);
+}
+
+static int draw_text_font(const canvas_t *c, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, int spacing, const char *str) {
+    if (!font || !font->data || !str)
+        return 0;
+    const int x_start = x;
+    while (*str) {
+        x += draw_char_font(c, x, y, fg, bg, font, mono, *str++);
+        canvas_rect(c, x, y, spacing, font->height, bg);
+        x += spacing;
+    }
+    return x - x_start;
+}
+
+int st7735_char_font(st7735_t *disp, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, char c) {
+    const canvas_t cv = view_canvas(disp);
+    return draw_char_font(&cv, x, y, fg, bg, font, mono, c);
+}
+int st7735_surface_char_font(st7735_surface_t *surface, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, char c) {
+    const canvas_t cv = surface_canvas(surface);
+    return draw_char_font(&cv, x, y, fg, bg, font, mono, c);
+}
+
+int st7735_text_font(st7735_t *disp, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, int spacing, const char *str) {
+    const canvas_t c = view_canvas(disp);
+    return draw_text_font(&c, x, y, fg, bg, font, mono, spacing, str);
+}
+int st7735_surface_text_font(st7735_surface_t *surface, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, int spacing,
+                             const char *str) {
+    const canvas_t c = surface_canvas(surface);
+    return draw_text_font(&c, x, y, fg, bg, font, mono, spacing, str);
+}
+
+#endif
+
+// ------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------
+
+static void draw_blit(const canvas_t *c, int x, int y, const st7735_surface_t *surface) {
+    if (!surface)
+        return;
+    canvas_place(c, &x, &y);
+    int cx = x, cy = y, w = surface->width, h = surface->height;
+    if (!canvas_clip(c, &cx, &cy, &w, &h))
+        return;
+    const uint16_t *src = surface->pixels + (cy - y) * surface->stride + (cx - x);
+    for (int py = 0; py < h; py++, src += surface->stride)
+        memcpy(canvas_row(c, cx, cy, w, py), src, (size_t)w * sizeof(uint16_t));
+    canvas_rows_done(c, cx, cy, w, h);
+}
+
+void st7735_blit(st7735_t *disp, int x, int y, const st7735_surface_t *surface) {
+    const canvas_t c = view_canvas(disp);
+    draw_blit(&c, x, y, surface);
+}
+void st7735_surface_blit(st7735_surface_t *dst, int x, int y, const st7735_surface_t *surface) {
+    const canvas_t c = surface_canvas(dst);
+    draw_blit(&c, x, y, surface);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+/* 16.16 fixed point source coordinates for each destination pixel: the division happens once per blit */
+#define FIXED_SHIFT 16
+#define FIXED_ONE   (1 << FIXED_SHIFT)
+
+static inline uint32_t fixed_step(int src, int dst) {
+    return (uint32_t)(((uint64_t)src << FIXED_SHIFT) / (uint64_t)dst);
+}
+
+static void scale_row_nearest(const uint16_t *src, uint16_t *dst, int w, uint32_t fx, uint32_t step) {
+    for (int i = 0; i < w; i++, fx += step)
+        dst[i] = src[fx >> FIXED_SHIFT];
+}
+
+/* Box (area average) filter. Box edges and reciprocal widths are precomputed per column and per row, so each output
+ * pixel costs one multiply instead of a division. Enlarging degenerates to nearest since every box is one pixel. */
+typedef struct {
+    uint16_t x0, x1;
+    uint32_t recip; /* 65536 / (x1 - x0) */
+} box_span_t;
+
+static void box_spans(box_span_t *spans, int first, int count, int src, uint32_t step) {
+    for (int i = 0; i < count; i++) {
+        uint32_t a = ((uint32_t)(first + i) * step) >> FIXED_SHIFT, b = ((uint32_t)(first + i + 1) * step) >> FIXED_SHIFT;
+        if (b > (uint32_t)src)
+            b = (uint32_t)src;
+        if (b <= a)
+            b = a + 1;
+        spans[i].x0 = (uint16_t)a;
+        spans[i].x1 = (uint16_t)b;
+        spans[i].recip = (uint32_t)FIXED_ONE / (b - a);
+    }
+}
+
+static void scale_row_box(const st7735_surface_t *surface, const box_span_t *xs, const box_span_t *ys, uint16_t *dst, int w) {
+    for (int i = 0; i < w; i++) {
+        uint32_t r = 0, g = 0, b = 0;
+        for (int sy = ys->x0; sy < ys->x1; sy++) {
+            const uint16_t *row = surface->pixels + sy * surface->stride;
+            for (int sx = xs[i].x0; sx < xs[i].x1; sx++) {
+                const uint16_t px = row[sx];
+                r += px >> 11;
+                g += (px >> 5) & 0x3F;
+                b += px & 0x1F;
+            }
+        }
+        /* 2^32 / area, from truncated factors so never above it: with the half unit added the average rounds to
+         * nearest and still cannot carry into the next channel */
+        const uint64_t recip = (uint64_t)xs[i].recip * ys->recip, half = 1ULL << 31;
+        dst[i] = (uint16_t)((((r * recip + half) >> 32) << 11) | (((g * recip + half) >> 32) << 5) | ((b * recip + half) >> 32));
+    }
+}
+
+static void draw_blit_scaled(const canvas_t *c, int x, int y, int w, int h, const st7735_surface_t *surface, int mode) {
+    if (!surface || w <= 0 || h <= 0 || surface->width >= 65536 || surface->height >= 65536)
+        return;
+    canvas_place(c, &x, &y);
+    int cx = x, cy = y, cw = w, ch = h;
+    if (!canvas_clip(c, &cx, &cy, &cw, &ch))
+        return;
+    const uint32_t step_x = fixed_step(surface->width, w), step_y = fixed_step(surface->height, h);
+    const int first_x = cx - x, first_y = cy - y;
+    if (mode == ST7735_SCALE_BOX && (step_x > FIXED_ONE || step_y > FIXED_ONE)) {
+        box_span_t *xs = malloc((size_t)cw * sizeof(box_span_t));
+        if (!xs) {
+            perror("malloc");
+            return;
+        }
+        box_spans(xs, first_x, cw, surface->width, step_x);
+        for (int py = 0; py < ch; py++) {
+            box_span_t ys;
+            box_spans(&ys, first_y + py, 1, surface->height, step_y);
+            scale_row_box(surface, xs, &ys, canvas_row(c, cx, cy, cw, py), cw);
+        }
+        free(xs);
+    } else {
+        /* sample at destination pixel centres */
+        const uint32_t fx = (uint32_t)first_x * step_x + step_x / 2;
+        uint32_t fy = (uint32_t)first_y * step_y + step_y / 2;
+        for (int py = 0; py < ch; py++, fy += step_y)
+            scale_row_nearest(surface->pixels + (int)(fy >> FIXED_SHIFT) * surface->stride, canvas_row(c, cx, cy, cw, py), cw, fx, step_x);
+    }
+    canvas_rows_done(c, cx, cy, cw, ch);
+}
+
+static void draw_blit_fit(const canvas_t *c, const st7735_surface_t *surface, int mode) {
+    if (!surface || surface->width <= 0 || surface->height <= 0)
+        return;
+    const int dw = c->clip_x2 - c->clip_x1, dh = c->clip_y2 - c->clip_y1;
+    if (dw <= 0 || dh <= 0)
+        return;
+    int w = dw, h = (int)((int64_t)surface->height * dw / surface->width);
+    if (h > dh) {
+        h = dh;
+        w = (int)((int64_t)surface->width * dh / surface->height);
+    }
+    draw_blit_scaled(c, c->clip_x1 - c->org_x + (dw - w) / 2, c->clip_y1 - c->org_y + (dh - h) / 2, w, h, surface, mode);
+}
+
+void st7735_blit_scaled(st7735_t *disp, int x, int y, int w, int h, const st7735_surface_t *surface, int mode) {
+    const canvas_t c = view_canvas(disp);
+    draw_blit_scaled(&c, x, y, w, h, surface, mode);
+}
+void st7735_surface_blit_scaled(st7735_surface_t *dst, int x, int y, int w, int h, const st7735_surface_t *surface, int mode) {
+    const canvas_t c = surface_canvas(dst);
+    draw_blit_scaled(&c, x, y, w, h, surface, mode);
+}
+
+void st7735_blit_fit(st7735_t *disp, const st7735_surface_t *surface, int mode) {
+    const canvas_t c = view_canvas(disp);
+    draw_blit_fit(&c, surface, mode);
+}
+void st7735_surface_blit_fit(st7735_surface_t *dst, const st7735_surface_t *surface, int mode) {
+    const canvas_t c = surface_canvas(dst);
+    draw_blit_fit(&c, surface, mode);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+static void draw_blit_rotated(const canvas_t *c, int x, int y, const st7735_surface_t *surface, int rotation) {
+    if (!surface)
+        return;
+    const int sw = surface->width, sh = surface->height, stride = surface->stride;
+    /* source offset of destination (0,0) and steps per destination column / row */
+    ptrdiff_t base, step_x, step_y;
+    int w, h;
+    switch (rotation) {
+    case ST7735_ROTATION_0:
+        base = 0, step_x = 1, step_y = stride, w = sw, h = sh;
+        break;
+    case ST7735_ROTATION_90:
+        base = (ptrdiff_t)(sh - 1) * stride, step_x = -stride, step_y = 1, w = sh, h = sw;
+        break;
+    case ST7735_ROTATION_180:
+        base = (ptrdiff_t)(sh - 1) * stride + (sw - 1), step_x = -1, step_y = -stride, w = sw, h = sh;
+        break;
+    case ST7735_ROTATION_270:
+        base = sw - 1, step_x = stride, step_y = -1, w = sh, h = sw;
+        break;
+    default:
+        return;
+    }
+    canvas_place(c, &x, &y);
+    int cx = x, cy = y, cw = w, ch = h;
+    if (!canvas_clip(c, &cx, &cy, &cw, &ch))
+        return;
+    const uint16_t *src = surface->pixels + base + (cx - x) * step_x + (cy - y) * step_y;
+    for (int py = 0; py < ch; py++, src += step_y) {
+        uint16_t *dst = canvas_row(c, cx, cy, cw, py);
+        const uint16_t *s = src;
+        for (int px = 0; px < cw; px++, s += step_x)
+            dst[px] = *s;
+    }
+    canvas_rows_done(c, cx, cy, cw, ch);
+}
+
+void st7735_blit_rotated(st7735_t *disp, int x, int y, const st7735_surface_t *surface, int rotation) {
+    const canvas_t c = view_canvas(disp);
+    draw_blit_rotated(&c, x, y, surface, rotation);
+}
+void st7735_surface_blit_rotated(st7735_surface_t *dst, int x, int y, const st7735_surface_t *surface, int rotation) {
+    const canvas_t c = surface_canvas(dst);
+    draw_blit_rotated(&c, x, y, surface, rotation);
+}
+
+/* Scanline polygon fill. Vertices are 16.16 fixed point with integers on pixel corners, and a pixel is inside when
+ * its centre is (even-odd rule, left and top edges inclusive), so shapes that share an edge never overlap and an
+ * axis-aligned square fills exactly what st7735_fill_rect would. Edges are sorted by first row into an edge table;
+ * each row adds the edges starting there to the active list, keeps that ordered by x and fills between pairs. */
+typedef struct {
+    int64_t x, dx; /* crossing at the current row centre, step per row */
+    int y0, y1;    /* rows covered, end exclusive */
+} poly_edge_t;
+
+#define POLY_HALF     (FIXED_ONE / 2)
+#define POLY_EDGES    64  /* edges handled without allocating */
+#define ARC_SEGMENTS  256 /* most segments per arc */
+#define POLY_LIMIT    (1 << 20) /* vertex clamp keeping the fixed point products in range */
+
+static inline int fixed_ceil(int64_t v) {
+    return (int)((v + FIXED_ONE - 1) >> FIXED_SHIFT);
+}
+
+/* Append the edges of the closed contour pts[0..count) (x,y pairs), skipping those that cross no row centre */
+static int poly_edges(poly_edge_t *edges, int n, const int64_t *pts, int count) {
+    for (int i = 0; i < count; i++) {
+        const int64_t *a = &pts[i * 2], *b = &pts[((i + 1) % count) * 2];
+        if (a[1] > b[1]) {
+            const int64_t *t = a;
+            a = b, b = t;
+        }
+        const int y0 = fixed_ceil(a[1] - POLY_HALF), y1 = fixed_ceil(b[1] - POLY_HALF);
+        if (y0 >= y1)
+            continue;
+        poly_edge_t *e = &edges[n++];
+        e->dx = ((b[0] - a[0]) * FIXED_ONE) / (b[1] - a[1]);
+        e->x = a[0] + (e->dx * ((int64_t)y0 * FIXED_ONE + POLY_HALF - a[1])) / FIXED_ONE;
+        e->y0 = y0;
+        e->y1 = y1;
+    }
+    return n;
+}
+
+static void poly_fill(const canvas_t *c, poly_edge_t *edges, int n, uint16_t color) {
+    if (n < 2)
+        return;
+    poly_edge_t *active_buf[POLY_EDGES], **active = active_buf;
+    if (n > POLY_EDGES && !(active = malloc((size_t)n * sizeof(poly_edge_t *)))) {
+        perror("malloc");
+        return;
+    }
+    /* edge table: insertion sort by first row, counts are small */
+    int y_end = INT_MIN;
+    for (int i = 1; i < n; i++)
+        for (int j = i; j > 0 && edges[j].y0 < edges[j - 1].y0; j--) {
+            const poly_edge_t t = edges[j];
+            edges[j] = edges[j - 1], edges[j - 1] = t;
+        }
+    for (int i = 0; i < n; i++)
+        if (edges[i].y1 > y_end)
+            y_end = edges[i].y1;
+    int y = edges[0].y0;
+    /* rows outside the clip are skipped, not walked: edges joining later are advanced to the first visible row */
+    if (y < c->clip_y1 - c->org_y)
+        y = c->clip_y1 - c->org_y;
+    if (y_end > c->clip_y2 - c->org_y)
+        y_end = c->clip_y2 - c->org_y;
+    int next = 0, count = 0;
+    for (; y < y_end; y++) {
+        for (; next < n && edges[next].y0 <= y; next++)
+            if (edges[next].y1 > y) {
+                edges[next].x += edges[next].dx * (y - edges[next].y0);
+                active[count++] = &edges[next];
+            }
+        int keep = 0;
+        for (int i = 0; i < count; i++)
+            if (active[i]->y1 > y)
+                active[keep++] = active[i];
+        count = keep;
+        for (int i = 1; i < count; i++) /* nearly sorted from the previous row */
+            for (int j = i; j > 0 && active[j]->x < active[j - 1]->x; j--) {
+                poly_edge_t *t = active[j];
+                active[j] = active[j - 1], active[j - 1] = t;
+            }
+        for (int i = 0; i + 1 < count; i += 2) {
+            const int x1 = fixed_ceil(active[i]->x - POLY_HALF), x2 = fixed_ceil(active[i + 1]->x - POLY_HALF);
+            if (x2 > x1)
+                canvas_rect(c, x1, y, x2 - x1, 1, color);
+        }
+        for (int i = 0; i < count; i++)
+            active[i]->x += active[i]->dx;
+    }
+    if (active != active_buf)
+        free(active);
+}
+
+static void draw_fill_polygon(const canvas_t *c, const st7735_point_t *points, int count, uint16_t color) {
+    if (!points || count < 3)
+        return;
+    int x1 = INT_MAX, y1 = INT_MAX, x2 = INT_MIN, y2 = INT_MIN;
+    for (int i = 0; i < count; i++) {
+        x1 = points[i].x < x1 ? points[i].x : x1, x2 = points[i].x > x2 ? points[i].x : x2;
+        y1 = points[i].y < y1 ? points[i].y : y1, y2 = points[i].y > y2 ? points[i].y : y2;
+    }
+    if (!canvas_visible(c, x1, y1, x2 - 1, y2 - 1))
+        return;
+    int64_t pts_buf[POLY_EDGES * 2], *pts = pts_buf;
+    poly_edge_t edges_buf[POLY_EDGES], *edges = edges_buf;
+    if (count > POLY_EDGES) {
+        pts = malloc((size_t)count * 2 * sizeof(int64_t));
+        edges = malloc((size_t)count * sizeof(poly_edge_t));
+        if (!pts || !edges) {
+            perror("malloc");
+            free(pts);
+            free(edges);
+            return;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        const int px = points[i].x < -POLY_LIMIT ? -POLY_LIMIT : (points[i].x > POLY_LIMIT ? POLY_LIMIT : points[i].x);
+        const int py = points[i].y < -POLY_LIMIT ? -POLY_LIMIT : (points[i].y > POLY_LIMIT ? POLY_LIMIT : points[i].y);
+        pts[i * 2] = (int64_t)px * FIXED_ONE;
+        pts[i * 2 + 1] = (int64_t)py * FIXED_ONE;
+    }
+    poly_fill(c, edges, poly_edges(edges, 0, pts, count), color);
+    if (count > POLY_EDGES) {
+        free(pts);
+        free(edges);
+    }
+}
+
+static void draw_fill_triangle(const canvas_t *c, int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color) {
+    const st7735_point_t points[3] = { { x0, y0 }, { x1, y1 }, { x2, y2 } };
+    draw_fill_polygon(c, points, 3, color);
+}
+
+/* Contour of radius r (pixels, from the centre of pixel x,y) from angle a0 sweeping by sweep radians, in n steps */
+static void arc_points(int64_t *pts, int x, int y, float r, float a0, float sweep, int n) {
+    for (int i = 0; i <= n; i++) {
+        const float a = a0 + sweep * (float)i / (float)n;
+        pts[i * 2] = (int64_t)(((float)x + 0.5f + r * cosf(a)) * (float)FIXED_ONE);
+        pts[i * 2 + 1] = (int64_t)(((float)y + 0.5f + r * sinf(a)) * (float)FIXED_ONE);
+    }
+}
+
+/* Annular sector as one polygon: the outer arc forwards then the inner arc (or the centre) back. A full turn is two
+ * closed circles instead, which even-odd fills as a ring. Segment count keeps the chord within a quarter pixel. */
+static void draw_fill_arc(const canvas_t *c, int x, int y, int r_outer, int r_inner, int start, int end, uint16_t color) {
+    if (r_outer < 0 || r_outer > POLY_LIMIT || r_inner < 0 || r_inner > r_outer || end == start || !canvas_visible(c, x - r_outer, y - r_outer, x + r_outer, y + r_outer))
+        return;
+    const bool full = abs(end - start) >= 360;
+    if (end < start)
+        end += ((start - end) / 360 + 1) * 360;
+    const float pi = 3.14159265f, ro = (float)r_outer + 0.5f, ri = r_inner > 0 ? (float)r_inner - 0.5f : 0.0f;
+    const float a0 = (float)start * pi / 180.0f, sweep = full ? 2.0f * pi : (float)(end - start) * pi / 180.0f;
+    const float step = ro > 0.25f ? 2.0f * acosf(1.0f - 0.25f / ro) : pi;
+    int n = (int)ceilf(sweep / step);
+    n = n < 4 ? 4 : (n > ARC_SEGMENTS ? ARC_SEGMENTS : n);
+    int64_t pts[(ARC_SEGMENTS + 1) * 2 * 2];
+    poly_edge_t edges[(ARC_SEGMENTS + 1) * 2];
+    int edge_count;
+    if (full) { /* the last point repeats the first, contours close by themselves */
+        arc_points(pts, x, y, ro, 0.0f, sweep, n);
+        edge_count = poly_edges(edges, 0, pts, n);
+        if (r_inner > 0) {
+            arc_points(pts, x, y, ri, 0.0f, sweep, n);
+            edge_count = poly_edges(edges, edge_count, pts, n);
+        }
+    } else {
+        arc_points(pts, x, y, ro, a0, sweep, n);
+        int count = n + 1;
+        if (r_inner > 0) {
+            arc_points(pts + count * 2, x, y, ri, a0, sweep, n);
+            for (int i = 0, j = n; i < j; i++, j--) { /* walk the inner arc backwards */
+                int64_t *p = pts + (count + i) * 2, *q = pts + (count + j) * 2, t0 = p[0], t1 = p[1];
+                p[0] = q[0], p[1] = q[1], q[0] = t0, q[1] = t1;
+            }
+            count += n + 1;
+        } else {
+            pts[count * 2] = (int64_t)x * FIXED_ONE + POLY_HALF;
+            pts[count * 2 + 1] = (int64_t)y * FIXED_ONE + POLY_HALF;
+            count++;
+        }
+        edge_count = poly_edges(edges, 0, pts, count);
+    }
+    poly_fill(c, edges, edge_count, color);
+}
+
+void st7735_fill_polygon(st7735_t *disp, const st7735_point_t *points, int count, uint16_t color) {
+    const canvas_t c = view_canvas(disp);
+    draw_fill_polygon(&c, points, count, color);
+}
+void st7735_surface_fill_polygon(st7735_surface_t *surface, const st7735_point_t *points, int count, uint16_t color) {
+    const canvas_t c = surface_canvas(surface);
+    draw_fill_polygon(&c, points, count, color);
+}
+
+void st7735_fill_triangle(st7735_t *disp, int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color) {
+    const canvas_t c = view_canvas(disp);
+    draw_fill_triangle(&c, x0, y0, x1, y1, x2, y2, color);
+}
+void st7735_surface_fill_triangle(st7735_surface_t *surface, int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color) {
+    const canvas_t c = surface_canvas(surface);
+    draw_fill_triangle(&c, x0, y0, x1, y1, x2, y2, color);
+}
+
+void st7735_fill_arc(st7735_t *disp, int x, int y, int r_outer, int r_inner, int start, int end, uint16_t color) {
+    const canvas_t c = view_canvas(disp);
+    draw_fill_arc(&c, x, y, r_outer, r_inner, start, end, color);
+}
+void st7735_surface_fill_arc(st7735_surface_t *surface, int x, int y, int r_outer, int r_inner, int start, int end, uint16_t color) {
+    const canvas_t c = surface_canvas(surface);
+    draw_fill_arc(&c, x, y, r_outer, r_inner, start, end, color);
+}
+
+/* RGB565 blending at 5-bit alpha a = 0..32: each field becomes (src * a + dst * (32 - a)) / 32. The SWAR form takes a
+ * pixel pair as one 32-bit word and splits it into two words of non-adjacent fields, each with room above it for the
+ * product: lo keeps R and B of one pixel and G of the other, hi (shifted down 5) the remaining three. A pair then costs
+ * two multiplies per operand, and with a constant colour the source products are computed once per call. A single
+ * pixel uses the same lo layout with itself as the other half. NEON does eight pixels at a time in 16-bit lanes. */
+#define BLEND_LO 0x07E0F81Fu
+#define BLEND_HI 0x07C0F83Fu
+
+static inline uint32_t blend_alpha(uint8_t alpha) {
+    return ((uint32_t)alpha + 4) >> 3;
+}
+
+static inline uint16_t blend_pixel(uint16_t src, uint16_t dst, uint32_t a) {
+    const uint32_t s = (src | (uint32_t)src << 16) & BLEND_LO, d = (dst | (uint32_t)dst << 16) & BLEND_LO;
+    const uint32_t x = ((s * a + d * (32 - a)) >> 5) & BLEND_LO;
+    return (uint16_t)(x | x >> 16);
+}
+
+/* src_lo / src_hi are the source pair's lo and hi words already multiplied by a */
+static inline uint32_t blend_pair(uint32_t src_lo, uint32_t src_hi, uint32_t dst, uint32_t inv) {
+    const uint32_t lo = ((src_lo + (dst & BLEND_LO) * inv) >> 5) & BLEND_LO;
+    const uint32_t hi = ((src_hi + ((dst >> 5) & BLEND_HI) * inv) >> 5) & BLEND_HI;
+    return lo | hi << 5;
+}
+
+#ifdef __ARM_NEON
+static inline uint16x8_t blend_neon(uint16x8_t sr, uint16x8_t sg, uint16x8_t sb, uint16x8_t d, uint16x8_t inv) {
+    const uint16x8_t r = vshrq_n_u16(vmlaq_u16(sr, vshrq_n_u16(d, 11), inv), 5);
+    const uint16x8_t g = vshrq_n_u16(vmlaq_u16(sg, vandq_u16(vshrq_n_u16(d, 5), vdupq_n_u16(0x3F)), inv), 5);
+    const uint16x8_t b = vshrq_n_u16(vmlaq_u16(sb, vandq_u16(d, vdupq_n_u16(0x1F)), inv), 5);
+    return vorrq_u16(vorrq_u16(vshlq_n_u16(r, 11), vshlq_n_u16(g, 5)), b);
+}
+#endif
+
+static void blend_fill_row(uint16_t *dst, int n, uint16_t color, uint32_t a) {
+    const uint32_t inv = 32 - a;
+    int i = 0;
+#ifdef __ARM_NEON
+    const uint16x8_t sr = vdupq_n_u16((uint16_t)((color >> 11) * a)), sg = vdupq_n_u16((uint16_t)(((color >> 5) & 0x3F) * a));
+    const uint16x8_t sb = vdupq_n_u16((uint16_t)((color & 0x1F) * a)), vinv = vdupq_n_u16((uint16_t)inv);
+    for (; i + 8 <= n; i += 8)
+        vst1q_u16(dst + i, blend_neon(sr, sg, sb, vld1q_u16(dst + i), vinv));
+#endif
+    const uint32_t pair = color | (uint32_t)color << 16;
+    const uint32_t src_lo = (pair & BLEND_LO) * a, src_hi = ((pair >> 5) & BLEND_HI) * a;
+    for (; i + 2 <= n; i += 2) {
+        uint32_t d;
+        memcpy(&d, dst + i, sizeof(d));
+        d = blend_pair(src_lo, src_hi, d, inv);
+        memcpy(dst + i, &d, sizeof(d));
+    }
+    if (i < n)
+        dst[i] = blend_pixel(color, dst[i], a);
+}
+
+static void blend_copy_row(uint16_t *dst, const uint16_t *src, int n, uint32_t a) {
+    const uint32_t inv = 32 - a;
+    int i = 0;
+#ifdef __ARM_NEON
+    const uint16x8_t va = vdupq_n_u16((uint16_t)a), vinv = vdupq_n_u16((uint16_t)inv);
+    for (; i + 8 <= n; i += 8) {
+        const uint16x8_t s = vld1q_u16(src + i);
+        const uint16x8_t sr = vmulq_u16(vshrq_n_u16(s, 11), va), sg = vmulq_u16(vandq_u16(vshrq_n_u16(s, 5), vdupq_n_u16(0x3F)), va);
+        const uint16x8_t sb = vmulq_u16(vandq_u16(s, vdupq_n_u16(0x1F)), va);
+        vst1q_u16(dst + i, blend_neon(sr, sg, sb, vld1q_u16(dst + i), vinv));
+    }
+#endif
+    for (; i + 2 <= n; i += 2) {
+        uint32_t s, d;
+        memcpy(&s, src + i, sizeof(s));
+        memcpy(&d, dst + i, sizeof(d));
+        d = blend_pair((s & BLEND_LO) * a, ((s >> 5) & BLEND_HI) * a, d, inv);
+        memcpy(dst + i, &d, sizeof(d));
+    }
+    if (i < n)
+        dst[i] = blend_pixel(src[i], dst[i], a);
+}
+
+/* Blending reads the destination, so it needs pixels in memory: -1 when drawing straight to the panel */
+static int draw_fill_rect_alpha(const canvas_t *c, int x, int y, int w, int h, uint16_t color, uint8_t alpha) {
+    if (!c->surface->pixels)
+        return -1;
+    const uint32_t a = blend_alpha(alpha);
+    if (a == 32) {
+        canvas_rect(c, x, y, w, h, color);
+        return 0;
+    }
+    canvas_place(c, &x, &y);
+    if (a == 0 || !canvas_clip(c, &x, &y, &w, &h))
+        return 0;
+    for (int py = 0; py < h; py++)
+        blend_fill_row(canvas_row(c, x, y, w, py), w, color, a);
+    canvas_rows_done(c, x, y, w, h);
+    return 0;
+}
+
+static int draw_blit_alpha(const canvas_t *c, int x, int y, const st7735_surface_t *surface, uint8_t alpha) {
+    if (!c->surface->pixels)
+        return -1;
+    if (!surface)
+        return 0;
+    const uint32_t a = blend_alpha(alpha);
+    if (a == 32) {
+        draw_blit(c, x, y, surface);
+        return 0;
+    }
+    canvas_place(c, &x, &y);
+    int cx = x, cy = y, w = surface->width, h = surface->height;
+    if (a == 0 || !canvas_clip(c, &cx, &cy, &w, &h))
+        return 0;
+    const uint16_t *src = surface->pixels + (cy - y) * surface->stride + (cx - x);
+    for (int py = 0; py < h; py++, src += surface->stride)
+        blend_copy_row(canvas_row(c, cx, cy, w, py), src, w, a);
+    canvas_rows_done(c, cx, cy, w, h);
+    return 0;
+}
+
+int st7735_fill_rect_alpha(st7735_t *disp, int x, int y, int w, int h, uint16_t color, uint8_t alpha) {
+    const canvas_t c = view_canvas(disp);
+    return draw_fill_rect_alpha(&c, x, y, w, h, color, alpha);
+}
+int st7735_surface_fill_rect_alpha(st7735_surface_t *surface, int x, int y, int w, int h, uint16_t color, uint8_t alpha) {
+    const canvas_t c = surface_canvas(surface);
+    return draw_fill_rect_alpha(&c, x, y, w, h, color, alpha);
+}
+
+int st7735_blit_alpha(st7735_t *disp, int x, int y, const st7735_surface_t *surface, uint8_t alpha) {
+    const canvas_t c = view_canvas(disp);
+    return draw_blit_alpha(&c, x, y, surface, alpha);
+}
+int st7735_surface_blit_alpha(st7735_surface_t *dst, int x, int y, const st7735_surface_t *surface, uint8_t alpha) {
+    const canvas_t c = surface_canvas(dst);
+    return draw_blit_alpha(&c, x, y, surface, alpha);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+/* Shift pixels within a region in memory: each destination row is one memmove from its source row, walking rows
+ * away from the direction of travel so sources are read before they are overwritten. The exposed strips are filled. */
+static int draw_scroll(const canvas_t *c, int x, int y, int w, int h, int dx, int dy, uint16_t fill) {
+    st7735_surface_t *s = c->surface;
+    if (!s->pixels)
+        return -1;
+    canvas_place(c, &x, &y);
+    if (!canvas_clip(c, &x, &y, &w, &h))
+        return 0;
+    if (abs(dx) >= w || abs(dy) >= h) {
+        canvas_fill(c, x, y, w, h, fill);
+        return 0;
+    }
+    const int len = w - abs(dx), dst_x = x + (dx > 0 ? dx : 0), src_x = x + (dx < 0 ? -dx : 0);
+    const int first = dy > 0 ? h - 1 : 0, last = dy > 0 ? dy : h - 1 + dy, step = dy > 0 ? -1 : 1;
+    for (int r = first;; r += step) {
+        memmove(s->pixels + (y + r) * s->stride + dst_x, s->pixels + (y + r - dy) * s->stride + src_x, (size_t)len * sizeof(uint16_t));
+        if (r == last)
+            break;
+    }
+    if (dy != 0)
+        canvas_fill(c, x, dy > 0 ? y : y + h + dy, w, abs(dy), fill);
+    if (dx != 0)
+        canvas_fill(c, dx > 0 ? x : x + w + dx, dy > 0 ? y + dy : y, abs(dx), h - abs(dy), fill);
+    if (c->disp)
+        dirty_mark(c->disp, x, y, x + w - 1, y + h - 1);
+    return 0;
+}
+
+int st7735_scroll_region(st7735_t *disp, int x, int y, int w, int h, int dx, int dy, uint16_t fill) {
+    const canvas_t c = view_canvas(disp);
+    return draw_scroll(&c, x, y, w, h, dx, dy, fill);
+}
+int st7735_surface_scroll(st7735_surface_t *surface, int x, int y, int w, int h, int dx, int dy, uint16_t fill) {
+    const canvas_t c = surface_canvas(surface);
+    return draw_scroll(&c, x, y, w, h, dx, dy, fill);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+/* Save-under: pushes copy a framebuffer rectangle onto a stack whose pixel pool only grows, so once warmed up popups
+ * allocate nothing. Pops copy it back and mark just that rectangle for the next flush. */
+int st7735_save_push(st7735_t *disp, int x, int y, int w, int h) {
+    if (!disp->screen.pixels)
+        return -1;
+    const canvas_t c = display_canvas(disp);
+    if (!canvas_clip(&c, &x, &y, &w, &h))
+        w = h = 0; /* keep pushes and pops paired */
+    if (disp->saves_count == disp->saves_capacity) {
+        const int capacity = disp->saves_capacity ? disp->saves_capacity * 2 : 4;
+        save_rect_t *saves = realloc(disp->saves, (size_t)capacity * sizeof(save_rect_t));
+        if (!saves) {
+            perror("realloc");
+            return -1;
+        }
+        disp->saves = saves;
+        disp->saves_capacity = capacity;
+    }
+    const size_t size = (size_t)w * (size_t)h;
+    if (disp->saved_used + size > disp->saved_size) {
+        uint16_t *saved = realloc(disp->saved, (disp->saved_used + size) * sizeof(uint16_t));
+        if (!saved) {
+            perror("realloc");
+            return -1;
+        }
+        disp->saved = saved;
+        disp->saved_size = disp->saved_used + size;
+    }
+    uint16_t *dst = disp->saved + disp->saved_used;
+    for (int row = 0; row < h; row++, dst += w)
+        memcpy(dst, disp->screen.pixels + (y + row) * disp->screen.stride + x, (size_t)w * sizeof(uint16_t));
+    disp->saved_used += size;
+    disp->saves[disp->saves_count++] = (save_rect_t) { x, y, w, h };
+    return 0;
+}
+
+int st7735_save_pop(st7735_t *disp) {
+    if (!disp->screen.pixels || disp->saves_count == 0)
+        return -1;
+    const save_rect_t *r = &disp->saves[--disp->saves_count];
+    disp->saved_used -= (size_t)r->w * (size_t)r->h;
+    const uint16_t *src = disp->saved + disp->saved_used;
+    for (int row = 0; row < r->h; row++, src += r->w)
+        memcpy(disp->screen.pixels + (r->y + row) * disp->screen.stride + r->x, src, (size_t)r->w * sizeof(uint16_t));
+    if (r->w > 0)
+        dirty_mark(disp, r->x, r->y, r->x + r->w - 1, r->y + r->h - 1);
+    return 0;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+/* Clip / viewport stack: each entry is already intersected with the one beneath it, so the drawing calls read only
+ * the top and a pop restores the outer state exactly */
+static int view_push(st7735_t *disp, int x, int y, int w, int h, bool move_origin) {
+    if (disp->views_count == disp->views_capacity) {
+        const int capacity = disp->views_capacity ? disp->views_capacity * 2 : 4;
+        view_t *views = realloc(disp->views, (size_t)capacity * sizeof(view_t));
+        if (!views) {
+            perror("realloc");
+            return -1;
+        }
+        disp->views = views;
+        disp->views_capacity = capacity;
+    }
+    const canvas_t c = view_canvas(disp);
+    canvas_place(&c, &x, &y);
+    const int org_x = move_origin ? x : c.org_x, org_y = move_origin ? y : c.org_y;
+    if (!canvas_clip(&c, &x, &y, &w, &h))
+        w = h = 0; /* empty: nothing draws until it is popped */
+    disp->views[disp->views_count++] = (view_t) { org_x, org_y, x, y, x + w, y + h };
+    return 0;
+}
+
+int st7735_clip_push(st7735_t *disp, int x, int y, int w, int h) {
+    return view_push(disp, x, y, w, h, false);
+}
+
+int st7735_viewport_push(st7735_t *disp, int x, int y, int w, int h) {
+    return view_push(disp, x, y, w, h, true);
+}
+
+int st7735_clip_pop(st7735_t *disp) {
+    if (disp->views_count == 0)
+        return -1;
+    disp->views_count--;
+    return 0;
+}
+
+void st7735_clip_reset(st7735_t *disp) {
+    disp->views_count = 0;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------
+
+typedef enum { DL_FILL, DL_FILL_RECT, DL_RECT, DL_LINE, DL_CIRCLE, DL_FILL_CIRCLE, DL_TEXT, DL_TEXT_FONT, DL_BLIT } dlist_op_t;
+
+#define DL_OPAQUE 0x01 /* paints every pixel of its bounds */
+#define DL_MONO   0x02
+
+/* Variable-length record in the list arena; text is stored inline after the header */
+typedef struct {
+    uint8_t op;
+    uint8_t flags;
+    int16_t spacing;
+    uint32_t size;          /* record bytes including text, a multiple of DL_ALIGN */
+    int16_t x1, y1, x2, y2; /* inclusive bounds */
+    int16_t a, b, c, d;     /* x,y,w,h or x0,y0,x1,y1 or x,y,r */
+    uint16_t fg, bg;
+    const void *ref; /* font or surface */
+    char text[];
+} dlist_cmd_t;
+
+#define DL_ALIGN _Alignof(dlist_cmd_t)
+
+/* Replay plan entry: a surviving command and its clipped bounds, grown when consecutive fills merge */
+typedef struct {
+    uint32_t offset;
+    int16_t x1, y1, x2, y2;
+} dlist_step_t;
+
+/* Command signature from the last replay, diffed by position to find what changed */
+typedef struct {
+    uint64_t hash;
+    int16_t x1, y1, x2, y2;
+} dlist_sig_t;
+
+struct st7735_dlist {
+    uint8_t *arena;
+    size_t used, size;
+    int count;
+
+    dlist_step_t *steps, *covers;
+    dlist_sig_t *sigs;
+    int capacity, steps_count;
+    int plan_width, plan_height; /* zero when the plan is stale */
+
+    dlist_sig_t *prev_sigs;
+    int prev_capacity, prev_count;
+    const st7735_t *prev_disp;
+};
+
+static inline const dlist_cmd_t *dlist_cmd_at(const st7735_dlist_t *dl, uint32_t offset) {
+    return (const dlist_cmd_t *)(const void *)(dl->arena + offset);
+}
+
+static inline int16_t clamp16(int v) {
+    return (int16_t)(v < INT16_MIN ? INT16_MIN : v > INT16_MAX ? INT16_MAX : v);
+}
+
+st7735_dlist_t *st7735_dlist_create(void) {
+    st7735_dlist_t *dl = calloc(1, sizeof(st7735_dlist_t));
+    if (!dl)
+        perror("calloc");
+    return dl;
+}
+
+void st7735_dlist_clear(st7735_dlist_t *dl) {
+    dl->used = 0;
+    dl->count = 0;
+    dl->plan_width = 0;
+}
+
+void st7735_dlist_destroy(st7735_dlist_t *dl) {
+    if (!dl)
+        return;
+    free(dl->arena);
+    free(dl->steps);
+    free(dl->covers);
+    free(dl->sigs);
+    free(dl->prev_sigs);
+    free(dl);
+}
+
+static dlist_cmd_t *dlist_add(st7735_dlist_t *dl, dlist_op_t op, uint8_t flags, int x1, int y1, int x2, int y2, const char *text) {
+    const size_t text_size = text ? strlen(text) + 1 : 0;
+    const size_t size = (sizeof(dlist_cmd_t) + text_size + DL_ALIGN - 1) & ~(DL_ALIGN - 1);
+    if (dl->used + size > dl->size) {
+        size_t grow = dl->size ? dl->size * 2 : 4096;
+        while (grow < dl->used + size)
+            grow *= 2;
+        uint8_t *arena = realloc(dl->arena, grow);
+        if (!arena) {
+            perror("realloc");
+            return NULL;
+        }
+        dl->arena = arena;
+        dl->size = grow;
+    }
+    dlist_cmd_t *cmd = (dlist_cmd_t *)(void *)(dl->arena + dl->used);
+    memset(cmd, 0, size); /* padding is hashed too */
+    cmd->op = (uint8_t)op;
+    cmd->flags = flags;
+    cmd->size = (uint32_t)size;
+    cmd->x1 = clamp16(x1);
+    cmd->y1 = clamp16(y1);
+    cmd->x2 = clamp16(x2);
+    cmd->y2 = clamp16(y2);
+    if (text)
+        memcpy(cmd->text, text, text_size);
+    dl->used += size;
+    dl->count++;
+    dl->plan_width = 0;
+    return cmd;
+}
+
+void st7735_dlist_fill(st7735_dlist_t *dl, uint16_t color) {
+    dlist_cmd_t *cmd = dlist_add(dl, DL_FILL, DL_OPAQUE, INT16_MIN, INT16_MIN, INT16_MAX, INT16_MAX, NULL);
+    if (cmd)
+        cmd->fg = color;
+}
+
+static void dlist_add_box(st7735_dlist_t *dl, dlist_op_t op, uint8_t flags, int x, int y, int w, int h, uint16_t color) {
+    if (w <= 0 || h <= 0)
+        return;
+    dlist_cmd_t *cmd = dlist_add(dl, op, flags, x, y, x + w - 1, y + h - 1, NULL);
+    if (cmd) {
+        cmd->a = clamp16(x), cmd->b = clamp16(y), cmd->c = clamp16(w), cmd->d = clamp16(h);
+        cmd->fg = color;
+    }
+}
+void st7735_dlist_fill_rect(st7735_dlist_t *dl, int x, int y, int w, int h, uint16_t color) {
+    dlist_add_box(dl, DL_FILL_RECT, DL_OPAQUE, x, y, w, h, color);
+}
+void st7735_dlist_rect(st7735_dlist_t *dl, int x, int y, int w, int h, uint16_t color) {
+    dlist_add_box(dl, DL_RECT, 0, x, y, w, h, color);
+}
+
+void st7735_dlist_line(st7735_dlist_t *dl, int x0, int y0, int x1, int y1, uint16_t color) {
+    dlist_cmd_t *cmd = dlist_add(dl, DL_LINE, 0, x0 < x1 ? x0 : x1, y0 < y1 ? y0 : y1, x0 < x1 ? x1 : x0, y0 < y1 ? y1 : y0, NULL);
+    if (cmd) {
+        cmd->a = clamp16(x0), cmd->b = clamp16(y0), cmd->c = clamp16(x1), cmd->d = clamp16(y1);
+        cmd->fg = color;
+    }
+}
+
+static void dlist_add_circle(st7735_dlist_t *dl, dlist_op_t op, int x, int y, int r, uint16_t color) {
+    dlist_cmd_t *cmd = dlist_add(dl, op, 0, x - r, y - r, x + r, y + r, NULL);
+    if (cmd) {
+        cmd->a = clamp16(x), cmd->b = clamp16(y), cmd->c = clamp16(r);
+        cmd->fg = color;
+    }
+}
+void st7735_dlist_circle(st7735_dlist_t *dl, int x, int y, int r, uint16_t color) {
+    dlist_add_circle(dl, DL_CIRCLE, x, y, r, color);
+}
+void st7735_dlist_fill_circle(st7735_dlist_t *dl, int x, int y, int r, uint16_t color) {
+    dlist_add_circle(dl, DL_FILL_CIRCLE, x, y, r, color);
+}
+
+/* Text paints its background over the whole string box, so it hides what is underneath unless spacing overlaps */
+static void dlist_add_text(st7735_dlist_t *dl, dlist_op_t op, uint8_t flags, int x, int y, int w, int h, uint16_t fg, uint16_t bg, int spacing,
+                           const void *font, const char *str) {
+    dlist_cmd_t *cmd = dlist_add(dl, op, (uint8_t)(flags | (spacing >= 0 ? DL_OPAQUE : 0)), x, y, x + w - 1, y + h - 1, str);
+    if (cmd) {
+        cmd->a = clamp16(x), cmd->b = clamp16(y);
+        cmd->fg = fg, cmd->bg = bg;
+        cmd->spacing = clamp16(spacing);
+        cmd->ref = font;
+    }
+}
+
+void st7735_dlist_text(st7735_dlist_t *dl, int x, int y, uint16_t fg, uint16_t bg, int spacing, const char *str) {
+    if (!str || !*str)
+        return;
+    dlist_add_text(dl, DL_TEXT, 0, x, y, (int)strlen(str) * (5 + spacing), 7, fg, bg, spacing, NULL, str);
+}
+
+#ifdef ST7735_EXTERNAL_FONTS
+static int font_glyph_width(const fontinfo_t *font, bool mono, char ch) {
+    if (ch < font->base || ch > font->limit)
+        ch = '?';
+    return mono ? font->width : (int)font->data[((font->width * ((font->height + 7) / 8)) + 1) * (ch - font->base)];
+}
+
+void st7735_dlist_text_font(st7735_dlist_t *dl, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, int spacing, const char *str) {
+    if (!font || !font->data || !str || !*str)
+        return;
+    int w = 0;
+    for (const char *p = str; *p; p++)
+        w += font_glyph_width(font, mono, *p) + spacing;
+    dlist_add_text(dl, DL_TEXT_FONT, mono ? DL_MONO : 0, x, y, w, font->height, fg, bg, spacing, font, str);
+}
+#endif
+
+void st7735_dlist_blit(st7735_dlist_t *dl, int x, int y, const st7735_surface_t *surface) {
+    if (!surface)
+        return;
+    dlist_cmd_t *cmd = dlist_add(dl, DL_BLIT, DL_OPAQUE, x, y, x + surface->width - 1, y + surface->height - 1, NULL);
+    if (cmd) {
+        cmd->a = clamp16(x), cmd->b = clamp16(y);
+        cmd->ref = surface;
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t dlist_hash(const void *data, size_t size) {
+    const uint8_t *p = data;
+    uint64_t hash = 0xCBF29CE484222325ULL; /* FNV-1a */
+    while (size--) {
+        hash ^= *p++;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static bool dlist_reserve(st7735_dlist_t *dl) {
+    if (dl->count <= dl->capacity)
+        return true;
+    const size_t capacity = (size_t)dl->count;
+    dlist_step_t *steps = realloc(dl->steps, capacity * sizeof(dlist_step_t));
+    if (steps)
+        dl->steps = steps;
+    dlist_step_t *covers = realloc(dl->covers, capacity * sizeof(dlist_step_t));
+    if (covers)
+        dl->covers = covers;
+    dlist_sig_t *sigs = realloc(dl->sigs, capacity * sizeof(dlist_sig_t));
+    if (sigs)
+        dl->sigs = sigs;
+    if (!steps || !covers || !sigs) {
+        perror("realloc");
+        return false;
+    }
+    dl->capacity = dl->count;
+    return true;
+}
+
+static inline bool step_contains(const dlist_step_t *outer, const dlist_step_t *inner) {
+    return inner->x1 >= outer->x1 && inner->x2 <= outer->x2 && inner->y1 >= outer->y1 && inner->y2 <= outer->y2;
+}
+
+/* Merge two consecutive fills of one colour when their union is a rectangle */
+static bool dlist_merge(const st7735_dlist_t *dl, dlist_step_t *prev, const dlist_step_t *next) {
+    const dlist_cmd_t *a = dlist_cmd_at(dl, prev->offset), *b = dlist_cmd_at(dl, next->offset);
+    if ((a->op != DL_FILL && a->op != DL_FILL_RECT) || (b->op != DL_FILL && b->op != DL_FILL_RECT) || a->fg != b->fg)
+        return false;
+    if (prev->y1 == next->y1 && prev->y2 == next->y2 && next->x1 <= prev->x2 + 1 && next->x2 + 1 >= prev->x1) {
+        prev->x1 = next->x1 < prev->x1 ? next->x1 : prev->x1;
+        prev->x2 = next->x2 > prev->x2 ? next->x2 : prev->x2;
+        return true;
+    }
+    if (prev->x1 == next->x1 && prev->x2 == next->x2 && next->y1 <= prev->y2 + 1 && next->y2 + 1 >= prev->y1) {
+        prev->y1 = next->y1 < prev->y1 ? next->y1 : prev->y1;
+        prev->y2 = next->y2 > prev->y2 ? next->y2 : prev->y2;
+        return true;
+    }
+    return false;
+}
+
+/* Build the replay plan for a screen size: sign every command, drop those off screen or hidden under a later opaque
+ * command, then merge consecutive fills. Kept until the list changes. */
+static bool dlist_plan(st7735_dlist_t *dl, int width, int height) {
+    if (dl->plan_width == width && dl->plan_height == height)
+        return true;
+    if (!dlist_reserve(dl))
+        return false;
+    int n = 0, i = 0;
+    for (size_t offset = 0; offset < dl->used; i++) {
+        const dlist_cmd_t *cmd = dlist_cmd_at(dl, (uint32_t)offset);
+        dl->sigs[i] = (dlist_sig_t) { dlist_hash(cmd, cmd->size), cmd->x1, cmd->y1, cmd->x2, cmd->y2 };
+        const dlist_step_t step = { (uint32_t)offset, cmd->x1 < 0 ? 0 : cmd->x1, cmd->y1 < 0 ? 0 : cmd->y1,
+                                    cmd->x2 >= width ? (int16_t)(width - 1) : cmd->x2, cmd->y2 >= height ? (int16_t)(height - 1) : cmd->y2 };
+        if (step.x1 <= step.x2 && step.y1 <= step.y2)
+            dl->steps[n++] = step;
+        offset += cmd->size;
+    }
+    int covers = 0;
+    for (int j = n - 1; j >= 0; j--) {
+        bool hidden = false;
+        for (int k = 0; k < covers && !hidden; k++)
+            hidden = step_contains(&dl->covers[k], &dl->steps[j]);
+        if (hidden)
+            dl->steps[j].offset = UINT32_MAX;
+        else if (dlist_cmd_at(dl, dl->steps[j].offset)->flags & DL_OPAQUE)
+            dl->covers[covers++] = dl->steps[j];
+    }
+    int kept = 0;
+    for (int j = 0; j < n; j++)
+        if (dl->steps[j].offset != UINT32_MAX && !(kept > 0 && dlist_merge(dl, &dl->steps[kept - 1], &dl->steps[j])))
+            dl->steps[kept++] = dl->steps[j];
+    dl->steps_count = kept;
+    dl->plan_width = width;
+    dl->plan_height = height;
+    return true;
+}
+
+static void dlist_exec(const canvas_t *c, const dlist_cmd_t *cmd, const dlist_step_t *step) {
+    switch ((dlist_op_t)cmd->op) {
+    case DL_FILL:
+    case DL_FILL_RECT:
+        canvas_rect(c, step->x1, step->y1, step->x2 - step->x1 + 1, step->y2 - step->y1 + 1, cmd->fg);
+        break;
+    case DL_RECT:
+        draw_rect(c, cmd->a, cmd->b, cmd->c, cmd->d, cmd->fg);
+        break;
+    case DL_LINE:
+        draw_line(c, cmd->a, cmd->b, cmd->c, cmd->d, cmd->fg);
+        break;
+    case DL_CIRCLE:
+        draw_circle(c, cmd->a, cmd->b, cmd->c, cmd->fg);
+        break;
+    case DL_FILL_CIRCLE:
+        draw_fill_circle(c, cmd->a, cmd->b, cmd->c, cmd->fg);
+        break;
+    case DL_TEXT:
+        draw_text(c, cmd->a, cmd->b, cmd->fg, cmd->bg, cmd->spacing, cmd->text);
+        break;
+    case DL_TEXT_FONT:
+#ifdef ST7735_EXTERNAL_FONTS
+        draw_text_font(c, cmd->a, cmd->b, cmd->fg, cmd->bg, cmd->ref, (cmd->flags & DL_MONO) != 0, cmd->spacing, cmd->text);
+#endif
+        break;
+    case DL_BLIT:
+        draw_blit(c, cmd->a, cmd->b, cmd->ref);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Rasterise the planned commands that reach the canvas clip area */
+static void dlist_replay(const st7735_dlist_t *dl, const canvas_t *c) {
+    for (int i = 0; i < dl->steps_count; i++) {
+        const dlist_step_t *step = &dl->steps[i];
+        if (step->x2 >= c->clip_x1 && step->x1 < c->clip_x2 && step->y2 >= c->clip_y1 && step->y1 < c->clip_y2)
+            dlist_exec(c, dlist_cmd_at(dl, step->offset), step);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+/* Banded rendering: the framebuffer is split into horizontal bands and each band replays the list through a canvas
+ * clipped to its rows. Bands are dealt out to per-worker queues and idle workers steal from the far end of other
+ * queues. A queue is one atomic word holding [next, end) so pop and steal are a single CAS. */
+
+struct render_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    pthread_t *threads;
+    struct render_worker *args;
+    int workers; /* including the caller as worker 0 */
+    unsigned generation;
+    int running;
+    bool stopping;
+    st7735_t *disp;
+    const st7735_dlist_t *dl;
+    int clip_x1, clip_y1, clip_x2, clip_y2;
+    int bands;
+    _Atomic uint32_t *queues;
+    st7735_band_timing_t *timings;
+};
+
+struct render_worker {
+    struct render_pool *pool;
+    int id;
+};
+
+static bool band_take(_Atomic uint32_t *queue, bool steal, int *band) {
+    uint32_t range = atomic_load(queue);
+    while (true) {
+        const uint32_t next = range & 0xFFFF, end = range >> 16;
+        if (next >= end)
+            return false;
+        const uint32_t taken = steal ? (((end - 1) << 16) | next) : ((end << 16) | (next + 1));
+        if (atomic_compare_exchange_weak(queue, &range, taken)) {
+            *band = (int)(steal ? end - 1 : next);
+            return true;
+        }
+    }
+}
+
+static void render_band(struct render_pool *pool, int band, int worker) {
+    st7735_t *disp = pool->disp;
+    const int y0 = band * disp->height / pool->bands, y1 = (band + 1) * disp->height / pool->bands;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    canvas_t c = surface_canvas(&disp->screen);
+    canvas_restrict(&c, pool->clip_x1, pool->clip_y1, pool->clip_x2, pool->clip_y2);
+    canvas_restrict(&c, 0, y0, disp->width - 1, y1 - 1);
+    dlist_replay(pool->dl, &c);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    st7735_band_timing_t *timing = &pool->timings[band];
+    timing->y = y0;
+    timing->height = y1 - y0;
+    timing->worker = worker;
+    timing->usec = (uint32_t)((t1.tv_sec - t0.tv_sec) * 1000000 + (t1.tv_nsec - t0.tv_nsec) / 1000);
+}
+
+static void render_work(struct render_pool *pool, int id) {
+    int band;
+    while (true) {
+        if (!band_take(&pool->queues[id], false, &band)) {
+            bool stolen = false;
+            for (int i = 1; i < pool->workers && !stolen; i++)
+                stolen = band_take(&pool->queues[(id + i) % pool->workers], true, &band);
+            if (!stolen)
+                return;
+        }
+        render_band(pool, band, id);
+    }
+}
+
+static void *render_thread(void *arg) {
+    const struct render_worker *worker = arg;
+    struct render_pool *pool = worker->pool;
+    unsigned seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (pool->generation == seen && !pool->stopping)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stopping)
+            break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        render_work(pool, worker->id);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void render_pool_destroy(struct render_pool *pool) {
+    if (!pool)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 1; i < pool->workers; i++)
+        pthread_join(pool->threads[i], NULL);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->args);
+    free(pool->queues);
+    free(pool->timings);
+    free(pool);
+}
+
+static struct render_pool *render_pool_create(st7735_t *disp, int threads, int bands) {
+    struct render_pool *pool = calloc(1, sizeof(struct render_pool));
+    if (!pool) {
+        perror("calloc");
+        return NULL;
+    }
+    pool->disp = disp;
+    pool->bands = bands;
+    pool->threads = calloc((size_t)threads, sizeof(pthread_t));
+    pool->args = calloc((size_t)threads, sizeof(struct render_worker));
+    pool->queues = calloc((size_t)threads, sizeof(_Atomic uint32_t));
+    pool->timings = calloc((size_t)bands, sizeof(st7735_band_timing_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->workers = 1;
+    if (!pool->threads || !pool->args || !pool->queues || !pool->timings) {
+        perror("calloc");
+        render_pool_destroy(pool);
+        return NULL;
+    }
+    for (int i = 0; i < threads; i++)
+        pool->args[i] = (struct render_worker) { pool, i };
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, render_thread, &pool->args[i]) != 0) {
+            perror("pthread_create");
+            break;
+        }
+        pool->workers++;
+    }
+    return pool;
+}
+
+static void render_pool_run(struct render_pool *pool, const st7735_dlist_t *dl, int x1, int y1, int x2, int y2) {
+    pthread_mutex_lock(&pool->lock);
+    pool->dl = dl;
+    pool->clip_x1 = x1;
+    pool->clip_y1 = y1;
+    pool->clip_x2 = x2;
+    pool->clip_y2 = y2;
+    for (int i = 0; i < pool->workers; i++) {
+        const uint32_t first = (uint32_t)(i * pool->bands / pool->workers), end = (uint32_t)((i + 1) * pool->bands / pool->workers);
+        atomic_store(&pool->queues[i], (end << 16) | first);
+    }
+    pool->running = pool->workers - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    render_work(pool, 0);
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int st7735_set_parallel(st7735_t *disp, int threads, int bands) {
+    render_pool_destroy(disp->render);
+    disp->render = NULL;
+    if (threads <= 1)
+        return 0;
+    if (bands <= 0)
+        bands = threads * 4;
+    if (bands > disp->height)
+        bands = disp->height;
+    disp->render = render_pool_create(disp, threads, bands);
+    return disp->render ? 0 : -1;
+}
+
+int st7735_parallel_timings(const st7735_t *disp, st7735_band_timing_t *timings, int max) {
+    if (!disp->render)
+        return 0;
+    const int count = disp->render->bands < max ? disp->render->bands : max;
+    memcpy(timings, disp->render->timings, (size_t)count * sizeof(st7735_band_timing_t));
+    return count;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+static inline void bounds_add(int *bounds, int x1, int y1, int x2, int y2) {
+    if (x1 < bounds[0])
+        bounds[0] = x1;
+    if (y1 < bounds[1])
+        bounds[1] = y1;
+    if (x2 > bounds[2])
+        bounds[2] = x2;
+    if (y2 > bounds[3])
+        bounds[3] = y2;
+}
+
+/* Plan the list, work out what it changes on screen, then rasterise only commands that reach that region. Nothing
+ * else may have drawn there since the previous replay for the incremental case to hold. */
+static void dlist_replay_damage(st7735_t *disp, st7735_dlist_t *dl, bool incremental) {
+    if (!dlist_plan(dl, disp->width, disp->height))
+        return;
+    int damage[4] = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+    if (incremental && dl->prev_disp == disp) {
+        const int n = dl->count > dl->prev_count ? dl->count : dl->prev_count;
+        for (int i = 0; i < n; i++) {
+            if (i < dl->count && i < dl->prev_count && dl->sigs[i].hash == dl->prev_sigs[i].hash)
+                continue;
+            if (i < dl->count)
+                bounds_add(damage, dl->sigs[i].x1, dl->sigs[i].y1, dl->sigs[i].x2, dl->sigs[i].y2);
+            if (i < dl->prev_count)
+                bounds_add(damage, dl->prev_sigs[i].x1, dl->prev_sigs[i].y1, dl->prev_sigs[i].x2, dl->prev_sigs[i].y2);
+        }
+        damage[0] = damage[0] < 0 ? 0 : damage[0];
+        damage[1] = damage[1] < 0 ? 0 : damage[1];
+        damage[2] = damage[2] >= disp->width ? disp->width - 1 : damage[2];
+        damage[3] = damage[3] >= disp->height ? disp->height - 1 : damage[3];
+    } else
+        for (int i = 0; i < dl->steps_count; i++)
+            bounds_add(damage, dl->steps[i].x1, dl->steps[i].y1, dl->steps[i].x2, dl->steps[i].y2);
+
+    if (dl->count > dl->prev_capacity) {
+        dlist_sig_t *prev_sigs = realloc(dl->prev_sigs, (size_t)dl->count * sizeof(dlist_sig_t));
+        if (prev_sigs) {
+            dl->prev_sigs = prev_sigs;
+            dl->prev_capacity = dl->count;
+        }
+    }
+    if (dl->count <= dl->prev_capacity) {
+        memcpy(dl->prev_sigs, dl->sigs, (size_t)dl->count * sizeof(dlist_sig_t));
+        dl->prev_count = dl->count;
+        dl->prev_disp = disp;
+    } else {
+        perror("realloc");
+        dl->prev_disp = NULL;
+    }
+
+    if (damage[0] > damage[2] || damage[1] > damage[3])
+        return;
+    if (disp->render && disp->screen.pixels)
+        render_pool_run(disp->render, dl, damage[0], damage[1], damage[2], damage[3]);
+    else {
+        /* buffered replays mark the damage once below rather than per primitive */
+        canvas_t c = disp->screen.pixels ? surface_canvas(&disp->screen) : display_canvas(disp);
+        canvas_restrict(&c, damage[0], damage[1], damage[2], damage[3]);
+        dlist_replay(dl, &c);
+    }
+    if (disp->screen.pixels)
+        dirty_mark(disp, damage[0], damage[1], damage[2], damage[3]);
+}
+
+static void dlist_render(st7735_t *disp, st7735_dlist_t *dl, bool incremental) {
+    const uint64_t trace = trace_begin(disp);
+    dlist_replay_damage(disp, dl, incremental);
+    trace_end(disp, trace, "render", "commands", (uint32_t)dl->count);
+}
+
+void st7735_dlist_draw(st7735_t *disp, st7735_dlist_t *dl) {
+    dlist_render(disp, dl, false);
+}
+
+void st7735_dlist_update(st7735_t *disp, st7735_dlist_t *dl) {
+    dlist_render(disp, dl, true);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------
+
+/* Command queue: a bounded MPSC ring of fixed-size slots (Vyukov style). Each slot carries a sequence number: equal
+ * to the position when free for that lap, position + 1 once written. Producers claim a position with one CAS on tail
+ * and publish by storing the sequence; the owner thread alone advances head. The owner sleeps on a condition variable
+ * only when the ring is empty, and producers touch the mutex only when it has said so. */
+
+#define QUEUE_FRAME 0xFF /* frame boundary marker, beside the dlist ops */
+#define QUEUE_MAX   (1 << 20)
+
+typedef struct {
+    uint8_t op;
+    bool mono;
+    int16_t spacing;
+    int a, b, c, d;
+    uint16_t fg, bg;
+    const void *ref; /* font or surface */
+    char text[ST7735_QUEUE_TEXT];
+} queue_cmd_t;
+
+typedef struct {
+    _Atomic uint32_t seq;
+    queue_cmd_t cmd;
+} queue_slot_t;
+
+struct st7735_queue {
+    st7735_t *disp;
+    queue_slot_t *slots;
+    uint32_t capacity, mask;
+    int policy, batch;
+    _Atomic uint32_t tail;
+    _Atomic uint32_t head;
+    _Atomic uint32_t high_water;
+    _Atomic uint64_t commands, rejected, frames;
+
+    st7735_dlist_t *dl; /* owner side: drained commands recorded for one replay */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    atomic_bool sleeping;
+    bool stopping;
+};
+
+static int queue_push(st7735_queue_t *q, const queue_cmd_t *cmd) {
+    queue_slot_t *slot;
+    uint32_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    while (true) {
+        slot = &q->slots[pos & q->mask];
+        const int32_t dif = (int32_t)(atomic_load_explicit(&slot->seq, memory_order_acquire) - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (dif < 0) {
+            atomic_fetch_add_explicit(&q->rejected, 1, memory_order_relaxed);
+            return -1;
+        } else
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    }
+    slot->cmd = *cmd;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    uint32_t depth = pos + 1 - atomic_load_explicit(&q->head, memory_order_relaxed);
+    if (depth > q->capacity) /* head read before the owner's latest pops */
+        depth = q->capacity;
+    uint32_t high = atomic_load_explicit(&q->high_water, memory_order_relaxed);
+    while (depth > high && !atomic_compare_exchange_weak_explicit(&q->high_water, &high, depth, memory_order_relaxed, memory_order_relaxed))
+        ;
+    /* pairs with the fence in queue_wait: either the owner sees this slot or this sees it sleeping */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&q->sleeping, memory_order_relaxed)) {
+        pthread_mutex_lock(&q->lock);
+        pthread_cond_signal(&q->wake);
+        pthread_mutex_unlock(&q->lock);
+    }
+    return 0;
+}
+
+static inline bool queue_ready(const st7735_queue_t *q) {
+    const uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    return atomic_load_explicit(&q->slots[head & q->mask].seq, memory_order_acquire) == head + 1;
+}
+
+static bool queue_pop(st7735_queue_t *q, queue_cmd_t *cmd) {
+    const uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    queue_slot_t *slot = &q->slots[head & q->mask];
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != head + 1)
+        return false;
+    *cmd = slot->cmd;
+    atomic_store_explicit(&slot->seq, head + q->capacity, memory_order_release);
+    atomic_store_explicit(&q->head, head + 1, memory_order_relaxed);
+    return true;
+}
+
+/* Returns false once stopping and drained. held: a paced flush is waiting, so sleep no later than its deadline. */
+static bool queue_wait(st7735_queue_t *q, bool held) {
+    const struct timespec deadline = frame_deadline(q->disp);
+    pthread_mutex_lock(&q->lock);
+    atomic_store_explicit(&q->sleeping, true, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (!queue_ready(q) && !q->stopping)
+        if (!held)
+            pthread_cond_wait(&q->wake, &q->lock);
+        else if (pthread_cond_timedwait(&q->wake, &q->lock, &deadline) == ETIMEDOUT)
+            break;
+    atomic_store_explicit(&q->sleeping, false, memory_order_relaxed);
+    const bool more = queue_ready(q) || !q->stopping;
+    pthread_mutex_unlock(&q->lock);
+    return more;
+}
+
+static void queue_record(st7735_dlist_t *dl, const queue_cmd_t *cmd) {
+    switch ((dlist_op_t)cmd->op) {
+    case DL_FILL:
+        st7735_dlist_fill(dl, cmd->fg);
+        break;
+    case DL_FILL_RECT:
+        st7735_dlist_fill_rect(dl, cmd->a, cmd->b, cmd->c, cmd->d, cmd->fg);
+        break;
+    case DL_RECT:
+        st7735_dlist_rect(dl, cmd->a, cmd->b, cmd->c, cmd->d, cmd->fg);
+        break;
+    case DL_LINE:
+        st7735_dlist_line(dl, cmd->a, cmd->b, cmd->c, cmd->d, cmd->fg);
+        break;
+    case DL_CIRCLE:
+        st7735_dlist_circle(dl, cmd->a, cmd->b, cmd->c, cmd->fg);
+        break;
+    case DL_FILL_CIRCLE:
+        st7735_dlist_fill_circle(dl, cmd->a, cmd->b, cmd->c, cmd->fg);
+        break;
+    case DL_TEXT:
+        st7735_dlist_text(dl, cmd->a, cmd->b, cmd->fg, cmd->bg, cmd->spacing, cmd->text);
+        break;
+    case DL_TEXT_FONT:
+#ifdef ST7735_EXTERNAL_FONTS
+        st7735_dlist_text_font(dl, cmd->a, cmd->b, cmd->fg, cmd->bg, cmd->ref, cmd->mono, cmd->spacing, cmd->text);
+#endif
+        break;
+    case DL_BLIT:
+        st7735_dlist_blit(dl, cmd->a, cmd->b, cmd->ref);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Owner: drain up to batch commands (0 = all pending) into the list and replay them; flush after every drain, or with
+ * ST7735_QUEUE_FRAMES only when a frame marker has been reached so a frame never reaches the panel half drawn. With
+ * frame pacing a flush may be held until the deadline: draining carries on into it, but a finished frame is sent
+ * before anything of the next one is drawn. */
+static void *queue_thread(void *arg) {
+    st7735_queue_t *q = arg;
+    queue_cmd_t cmd;
+    bool held = false;
+    while (true) {
+        if (held && q->policy == ST7735_QUEUE_FRAMES) {
+            frame_sleep(q->disp);
+            st7735_flush(q->disp);
+            held = false;
+            continue;
+        }
+        if (!queue_wait(q, held))
+            break;
+        int taken = 0;
+        bool boundary = false;
+        while ((q->batch == 0 || taken < q->batch) && queue_pop(q, &cmd)) {
+            if (cmd.op == QUEUE_FRAME) {
+                atomic_fetch_add_explicit(&q->frames, 1, memory_order_relaxed);
+                boundary = true;
+                if (q->policy == ST7735_QUEUE_FRAMES)
+                    break;
+                continue;
+            }
+            queue_record(q->dl, &cmd);
+            taken++;
+        }
+        atomic_fetch_add_explicit(&q->commands, (uint64_t)taken, memory_order_relaxed);
+        if (taken > 0) {
+            st7735_dlist_draw(q->disp, q->dl);
+            st7735_dlist_clear(q->dl);
+        }
+        if (q->policy != ST7735_QUEUE_FRAMES || boundary || held) {
+            st7735_flush(q->disp);
+            held = q->disp->frame_period_ns && q->disp->dirty;
+        }
+    }
+    flush_now(q->disp);
+    return NULL;
+}
+
+st7735_queue_t *st7735_queue_create(st7735_t *disp, int capacity, int policy, int batch) {
+    if (capacity < 2 || capacity > QUEUE_MAX || (capacity & (capacity - 1)) != 0 || batch < 0)
+        return NULL;
+    st7735_queue_t *q = calloc(1, sizeof(st7735_queue_t));
+    if (!q) {
+        perror("calloc");
+        return NULL;
+    }
+    q->slots = calloc((size_t)capacity, sizeof(queue_slot_t));
+    q->dl = st7735_dlist_create();
+    if (!q->slots || !q->dl) {
+        perror("calloc");
+        st7735_dlist_destroy(q->dl);
+        free(q->slots);
+        free(q);
+        return NULL;
+    }
+    q->disp = disp;
+    q->capacity = (uint32_t)capacity;
+    q->mask = (uint32_t)capacity - 1;
+    q->policy = policy;
+    q->batch = batch;
+    for (uint32_t i = 0; i < q->capacity; i++)
+        atomic_init(&q->slots[i].seq, i);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC); /* frame deadlines */
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&q->thread, NULL, queue_thread, q) != 0) {
+        perror("pthread_create");
+        pthread_cond_destroy(&q->wake);
+        pthread_mutex_destroy(&q->lock);
+        st7735_dlist_destroy(q->dl);
+        free(q->slots);
+        free(q);
+        return NULL;
+    }
+    return q;
+}
+
+void st7735_queue_destroy(st7735_queue_t *q) {
+    if (!q)
+        return;
+    pthread_mutex_lock(&q->lock);
+    q->stopping = true;
+    pthread_cond_signal(&q->wake);
+    pthread_mutex_unlock(&q->lock);
+    pthread_join(q->thread, NULL);
+    pthread_cond_destroy(&q->wake);
+    pthread_mutex_destroy(&q->lock);
+    st7735_dlist_destroy(q->dl);
+    free(q->slots);
+    free(q);
+}
+
+static inline int queue_shape(st7735_queue_t *q, dlist_op_t op, int a, int b, int c, int d, uint16_t color) {
+    const queue_cmd_t cmd = { .op = (uint8_t)op, .a = a, .b = b, .c = c, .d = d, .fg = color };
+    return queue_push(q, &cmd);
+}
+static int queue_text(st7735_queue_t *q, dlist_op_t op, int x, int y, uint16_t fg, uint16_t bg, const void *font, bool mono, int spacing, const char *str) {
+    if (!str)
+        return -1;
+    queue_cmd_t cmd = { .op = (uint8_t)op, .mono = mono, .spacing = clamp16(spacing), .a = x, .b = y, .fg = fg, .bg = bg, .ref = font };
+    const size_t len = strlen(str);
+    if (len >= sizeof(cmd.text))
+        return -1;
+    memcpy(cmd.text, str, len + 1);
+    return queue_push(q, &cmd);
+}
+
+int st7735_queue_fill(st7735_queue_t *q, uint16_t color) {
+    return queue_shape(q, DL_FILL, 0, 0, 0, 0, color);
+}
+int st7735_queue_fill_rect(st7735_queue_t *q, int x, int y, int w, int h, uint16_t color) {
+    return queue_shape(q, DL_FILL_RECT, x, y, w, h, color);
+}
+int st7735_queue_rect(st7735_queue_t *q, int x, int y, int w, int h, uint16_t color) {
+    return queue_shape(q, DL_RECT, x, y, w, h, color);
+}
+int st7735_queue_line(st7735_queue_t *q, int x0, int y0, int x1, int y1, uint16_t color) {
+    return queue_shape(q, DL_LINE, x0, y0, x1, y1, color);
+}
+int st7735_queue_circle(st7735_queue_t *q, int x, int y, int r, uint16_t color) {
+    return queue_shape(q, DL_CIRCLE, x, y, r, 0, color);
+}
+int st7735_queue_fill_circle(st7735_queue_t *q, int x, int y, int r, uint16_t color) {
+    return queue_shape(q, DL_FILL_CIRCLE, x, y, r, 0, color);
+}
+int st7735_queue_text(st7735_queue_t *q, int x, int y, uint16_t fg, uint16_t bg, int spacing, const char *str) {
+    return queue_text(q, DL_TEXT, x, y, fg, bg, NULL, false, spacing, str);
+}
+#ifdef ST7735_EXTERNAL_FONTS
+int st7735_queue_text_font(st7735_queue_t *q, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, int spacing, const char *str) {
+    return queue_text(q, DL_TEXT_FONT, x, y, fg, bg, font, mono, spacing, str);
+}
+#endif
+int st7735_queue_blit(st7735_queue_t *q, int x, int y, const st7735_surface_t *surface) {
+    const queue_cmd_t cmd = { .op = DL_BLIT, .a = x, .b = y, .ref = surface };
+    return queue_push(q, &cmd);
+}
+int st7735_queue_frame(st7735_queue_t *q) {
+    const queue_cmd_t cmd = { .op = QUEUE_FRAME };
+    return queue_push(q, &cmd);
+}
+
+int st7735_queue_set_realtime(st7735_queue_t *q, const st7735_realtime_t *rt) {
+    bool locked = false;
+    const int result = realtime_apply(q->thread, rt, &locked);
+    st7735_flush_latency_reset(q->disp);
+    return result;
+}
+
+void st7735_queue_stats(const st7735_queue_t *q, st7735_queue_stats_t *stats) {
+    const uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    const uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    stats->capacity = q->capacity;
+    stats->depth = tail - head;
+    stats->high_water = atomic_load_explicit(&q->high_water, memory_order_relaxed);
+    stats->commands = atomic_load_explicit(&q->commands, memory_order_relaxed);
+    stats->rejected = atomic_load_explicit(&q->rejected, memory_order_relaxed);
+    stats->frames = atomic_load_explicit(&q->frames, memory_order_relaxed);
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------------------------------------------------
+
+void st7735_scroll_setup(st7735_t *disp, int top_fixed, int scroll_area, int bottom_fixed) {
+    const uint8_t data[6] = { (uint8_t)(top_fixed >> 8),     (uint8_t)(top_fixed & 0xFF),  (uint8_t)(scroll_area >> 8),
+                              (uint8_t)(scroll_area & 0xFF), (uint8_t)(bottom_fixed >> 8), (uint8_t)(bottom_fixed & 0xFF) };
+    cmd(disp, ST7735_VSCRDEF);
+    dat_buf(disp, data, sizeof(data));
+}
+
+void st7735_scroll(st7735_t *disp, int line) {
+    const uint8_t data[2] = { (uint8_t)(line >> 8), (uint8_t)(line & 0xFF) };
+    cmd(disp, ST7735_VSCRSADD);
+    dat_buf(disp, data, sizeof(data));
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+/* Log console over the scroll area between a fixed header and footer. The area is a ring of GRAM rows: screen row
+ * top + k shows stored row (k + offset) % rows, so appending a line only draws it over the rows leaving the top and
+ * advances VSCRSADD. The controller scrolls along its own row axis, which is x at 90/270 rotation; there the area is
+ * scrolled in the framebuffer, or when unbuffered the visible lines are redrawn from a history. */
+
+#define CONSOLE_LINE_MAX 256
+
+struct st7735_console {
+    st7735_t *disp;
+    int top, rows;     /* scroll area in screen rows */
+    int line_height;
+    int offset;        /* stored row shown at the top of the area */
+    uint16_t fg, bg;
+#ifdef ST7735_EXTERNAL_FONTS
+    const fontinfo_t *font;
+    bool mono;
+#endif
+    bool hardware;
+    int tfa;           /* GRAM row where the scroll area starts */
+    st7735_surface_t *line;
+    char **history;    /* visible lines for the redraw fallback, newest at history_next - 1 */
+    int history_size, history_next;
+};
+
+static void console_scroll(const st7735_console_t *con) {
+    /* with MY set (180) GRAM rows run bottom to top, so the start address counts the other way */
+    const int shift = con->disp->rotation == 180 ? (con->rows - con->offset) % con->rows : con->offset;
+    st7735_scroll(con->disp, con->tfa + shift);
+}
+
+static void console_render(st7735_console_t *con, const char *text) {
+    const canvas_t c = surface_canvas(con->line);
+    canvas_rect(&c, 0, 0, con->line->width, con->line->height, con->bg);
+    if (!text)
+        return;
+#ifdef ST7735_EXTERNAL_FONTS
+    if (con->font) {
+        draw_text_font(&c, 0, 0, con->fg, con->bg, con->font, con->mono, 1, text);
+        return;
+    }
+#endif
+    draw_text(&c, 0, 0, con->fg, con->bg, 1, text);
+}
+
+/* Draw the rendered line at stored row y of the scroll area, wrapping past its end */
+static void console_put(const st7735_console_t *con, int y) {
+    canvas_t c = display_canvas(con->disp);
+    canvas_restrict(&c, 0, con->top, con->disp->width - 1, con->top + con->rows - 1);
+    draw_blit(&c, 0, con->top + y, con->line);
+    if (y + con->line_height > con->rows)
+        draw_blit(&c, 0, con->top + y - con->rows, con->line);
+}
+
+static void console_redraw(st7735_console_t *con) {
+    for (int i = 1, y = con->rows - con->line_height; y + con->line_height > 0 && i <= con->history_size; i++, y -= con->line_height) {
+        console_render(con, con->history[(con->history_next - i + con->history_size) % con->history_size]);
+        console_put(con, y);
+    }
+}
+
+static int console_line_height(const st7735_console_t *con) {
+#ifdef ST7735_EXTERNAL_FONTS
+    if (con->font)
+        return con->font->height;
+#endif
+    return 8;
+}
+
+static int console_layout(st7735_console_t *con) {
+    con->line_height = console_line_height(con);
+    if (con->line_height > con->rows) {
+        fprintf(stderr, "st7735: console line height %d exceeds scroll area %d\n", con->line_height, con->rows);
+        return -1;
+    }
+    st7735_surface_destroy(con->line);
+    con->line = st7735_surface_create(con->disp->width, con->line_height);
+    if (!con->line) {
+        perror("malloc");
+        return -1;
+    }
+    if (!con->hardware) {
+        for (int i = 0; i < con->history_size; i++)
+            free(con->history[i]);
+        free(con->history);
+        con->history_size = con->rows / con->line_height + 1;
+        con->history_next = 0;
+        con->history = calloc((size_t)con->history_size, sizeof(char *));
+        if (!con->history) {
+            perror("calloc");
+            return -1;
+        }
+    }
+    st7735_console_clear(con);
+    return 0;
+}
+
+st7735_console_t *st7735_console_create(st7735_t *disp, int top_fixed, int bottom_fixed, uint16_t fg, uint16_t bg) {
+    if (top_fixed < 0 || bottom_fixed < 0 || top_fixed + bottom_fixed >= disp->height)
+        return NULL;
+    st7735_console_t *con = calloc(1, sizeof(st7735_console_t));
+    if (!con) {
+        perror("calloc");
+        return NULL;
+    }
+    con->disp = disp;
+    con->top = top_fixed;
+    con->rows = disp->height - top_fixed - bottom_fixed;
+    con->fg = fg;
+    con->bg = bg;
+    con->hardware = disp->rotation == 0 || disp->rotation == 180;
+    if (con->hardware) {
+        /* scroll area in GRAM rows, which are flipped relative to the screen at 180 */
+        const int margin = disp->rotation == 180 ? ST7735_ROWS - disp->offset_top - disp->height + bottom_fixed : disp->offset_top + top_fixed;
+        con->tfa = margin;
+        st7735_scroll_setup(disp, margin, con->rows, ST7735_ROWS - margin - con->rows);
+    }
+    if (console_layout(con) < 0) {
+        st7735_console_destroy(con);
+        return NULL;
+    }
+    return con;
+}
+
+void st7735_console_destroy(st7735_console_t *con) {
+    if (!con)
+        return;
+    if (con->hardware) {
+        con->offset = 0;
+        console_scroll(con);
+    }
+    for (int i = 0; i < con->history_size; i++)
+        free(con->history[i]);
+    free(con->history);
+    st7735_surface_destroy(con->line);
+    free(con);
+}
+
+#ifdef ST7735_EXTERNAL_FONTS
+int st7735_console_set_font(st7735_console_t *con, const fontinfo_t *font, bool mono) {
+    con->font = font && font->data ? font : NULL;
+    con->mono = mono;
+    return console_layout(con);
+}
+#endif
+
+void st7735_console_set_colors(st7735_console_t *con, uint16_t fg, uint16_t bg) {
+    con->fg = fg;
+    con->bg = bg;
 }
 
-int st7735_char(st7735_t *disp, int x, int y, uint16_t fg, uint16_t bg, char c) {
-    if (c < 32 || c > 126)
-        c = '?';
-    const int char_height = 7, char_offs = c - 32, char_width = 5;
-    for (int i = 0; i < char_width; i++) {
-        const uint8_t char_byte = font5x7[char_offs * char_width + i];
-        for (int j = 0; j < char_height; j++)
-            st7735_pixel(disp, x + i, y + j, (char_byte & (1 << j)) ? fg : bg);
+void st7735_console_clear(st7735_console_t *con) {
+    con->offset = 0;
+    if (con->hardware)
+        console_scroll(con);
+    for (int i = 0; i < con->history_size; i++) {
+        free(con->history[i]);
+        con->history[i] = NULL;
     }
-    return char_width;
+    const canvas_t c = display_canvas(con->disp);
+    canvas_rect(&c, 0, con->top, con->disp->width, con->rows, con->bg);
+    if (st7735_is_buffered(con->disp))
+        st7735_flush(con->disp);
 }
 
-int st7735_text(st7735_t *disp, int x, int y, uint16_t fg, uint16_t bg, int spacing, const char *str) {
+/* Without its history copy the line is still shown, and comes back blank if the console has to redraw */
+static int console_line(st7735_console_t *con, const char *text) {
+    int result = 0;
+    if (con->hardware) {
+        const int y = con->offset;
+        con->offset = (con->offset + con->line_height) % con->rows;
+        console_scroll(con);
+        console_render(con, text);
+        console_put(con, y);
+    } else {
+        free(con->history[con->history_next]);
+        con->history[con->history_next] = strdup(text);
+        if (!con->history[con->history_next]) {
+            perror("strdup");
+            result = -1;
+        }
+        con->history_next = (con->history_next + 1) % con->history_size;
+        const canvas_t c = display_canvas(con->disp);
+        if (draw_scroll(&c, 0, con->top, con->disp->width, con->rows, 0, -con->line_height, con->bg) == 0) {
+            console_render(con, text);
+            console_put(con, con->rows - con->line_height);
+        } else
+            console_redraw(con);
+    }
+    return result;
+}
+
+int st7735_console_print(st7735_console_t *con, const char *str) {
     if (!str)
-        return 0;
-    const int x_start = x;
-    const int char_height = 7;
-    while (*str) {
-        x += st7735_char(disp, x, y, fg, bg, *str++);
-        x += st7735_char_space(disp, x, y, bg, char_height, spacing);
+        return -1;
+    char text[CONSOLE_LINE_MAX];
+    int result = 0;
+    do {
+        const char *end = strchr(str, '\n');
+        size_t len = end ? (size_t)(end - str) : strlen(str);
+        if (len >= sizeof(text))
+            len = sizeof(text) - 1;
+        memcpy(text, str, len);
+        text[len] = '\0';
+        if (console_line(con, text) < 0)
+            result = -1;
+        str = end ? end + 1 : NULL;
+    } while (str && *str);
+    if (st7735_is_buffered(con->disp))
+        st7735_flush(con->disp);
+    return result;
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+/* Rolling chart: samples are decimated into columns (min, max and last value of each group) kept in a ring as wide as
+ * the chart. Completing a column scrolls the plot left by one pixel and draws only that column; each column spans
+ * its min..max joined to the previous column's last value, so the trace stays continuous at any decimation. */
+
+typedef struct {
+    float min, max, last;
+    bool valid;
+} chart_column_t;
+
+struct st7735_chart {
+    st7735_t *disp;
+    int x, y, w, h;
+    int plot_x, plot_w; /* plot area right of the axis labels */
+    float min, max;
+    uint16_t fg, bg, axis;
+    int decimation;
+    chart_column_t *ring;
+    int ring_size, ring_head, ring_count; /* slots, next slot, columns stored */
+    chart_column_t pending;               /* column being accumulated */
+    int pending_samples;
+};
+
+static int chart_row(const st7735_chart_t *chart, float value) {
+    const float t = chart->max > chart->min ? (value - chart->min) / (chart->max - chart->min) : 0.5f;
+    const int row = (int)((1.0f - t) * (float)(chart->h - 1) + 0.5f);
+    return chart->y + (row < 0 ? 0 : row >= chart->h ? chart->h - 1 : row);
+}
+
+/* Draw the column of the given age (0 is newest) at plot column px */
+static void chart_column(const st7735_chart_t *chart, int px, int age) {
+    const int i = (chart->ring_head - 1 - age + chart->ring_size) % chart->ring_size;
+    const chart_column_t *col = &chart->ring[i];
+    const canvas_t c = display_canvas(chart->disp);
+    canvas_rect(&c, chart->plot_x + px, chart->y, 1, chart->h, chart->bg);
+    if (!col->valid)
+        return;
+    float lo = col->min, hi = col->max;
+    if (age + 1 < chart->ring_count) {
+        const chart_column_t *prev = &chart->ring[(i - 1 + chart->ring_size) % chart->ring_size];
+        if (prev->valid) {
+            lo = prev->last < lo ? prev->last : lo;
+            hi = prev->last > hi ? prev->last : hi;
+        }
     }
-    return x - x_start;
+    const int top = chart_row(chart, hi), bottom = chart_row(chart, lo);
+    canvas_rect(&c, chart->plot_x + px, top, 1, bottom - top + 1, chart->fg);
+}
+
+static void chart_plot(const st7735_chart_t *chart) {
+    const int columns = chart->ring_count < chart->plot_w ? chart->ring_count : chart->plot_w;
+    const canvas_t c = display_canvas(chart->disp);
+    canvas_rect(&c, chart->plot_x, chart->y, chart->plot_w - columns, chart->h, chart->bg);
+    for (int age = 0; age < columns; age++)
+        chart_column(chart, chart->plot_w - 1 - age, age);
+}
+
+/* Axis labels (range ends, built-in font) and an axis line take a gutter sized to the longer label */
+static void chart_axis(st7735_chart_t *chart) {
+    char hi[16], lo[16];
+    snprintf(hi, sizeof(hi), "%.4g", (double)chart->max);
+    snprintf(lo, sizeof(lo), "%.4g", (double)chart->min);
+    const size_t len = strlen(hi) > strlen(lo) ? strlen(hi) : strlen(lo);
+    int gutter = (int)len * 6 + 1;
+    if (chart->h < 16 || gutter >= chart->w / 2)
+        gutter = 0;
+    chart->plot_x = chart->x + gutter;
+    chart->plot_w = chart->w - gutter;
+    if (!gutter)
+        return;
+    const canvas_t c = display_canvas(chart->disp);
+    canvas_rect(&c, chart->x, chart->y, gutter - 1, chart->h, chart->bg);
+    draw_text(&c, chart->x, chart->y, chart->axis, chart->bg, 1, hi);
+    draw_text(&c, chart->x, chart->y + chart->h - 7, chart->axis, chart->bg, 1, lo);
+    canvas_rect(&c, chart->plot_x - 1, chart->y, 1, chart->h, chart->axis);
+}
+
+st7735_chart_t *st7735_chart_create(st7735_t *disp, int x, int y, int w, int h, float min, float max) {
+    if (w < 2 || h < 2)
+        return NULL;
+    st7735_chart_t *chart = calloc(1, sizeof(st7735_chart_t));
+    if (!chart) {
+        perror("calloc");
+        return NULL;
+    }
+    chart->ring = calloc((size_t)w, sizeof(chart_column_t));
+    if (!chart->ring) {
+        perror("calloc");
+        free(chart);
+        return NULL;
+    }
+    chart->disp = disp;
+    chart->x = x;
+    chart->y = y;
+    chart->w = w;
+    chart->h = h;
+    chart->min = min;
+    chart->max = max;
+    chart->fg = COLOR_GREEN;
+    chart->bg = COLOR_BLACK;
+    chart->axis = COLOR_WHITE;
+    chart->decimation = 1;
+    chart->ring_size = w;
+    st7735_chart_redraw(chart);
+    return chart;
+}
+
+void st7735_chart_destroy(st7735_chart_t *chart) {
+    if (!chart)
+        return;
+    free(chart->ring);
+    free(chart);
+}
+
+void st7735_chart_set_colors(st7735_chart_t *chart, uint16_t fg, uint16_t bg, uint16_t axis) {
+    chart->fg = fg;
+    chart->bg = bg;
+    chart->axis = axis;
+    st7735_chart_redraw(chart);
+}
+
+void st7735_chart_set_range(st7735_chart_t *chart, float min, float max) {
+    chart->min = min;
+    chart->max = max;
+    st7735_chart_redraw(chart);
+}
+
+void st7735_chart_set_decimation(st7735_chart_t *chart, int samples_per_column) {
+    chart->decimation = samples_per_column > 1 ? samples_per_column : 1;
+}
+
+void st7735_chart_redraw(st7735_chart_t *chart) {
+    chart_axis(chart);
+    chart_plot(chart);
+}
+
+void st7735_chart_clear(st7735_chart_t *chart) {
+    chart->ring_head = 0;
+    chart->ring_count = 0;
+    chart->pending_samples = 0;
+    chart_plot(chart);
+}
+
+void st7735_chart_push(st7735_chart_t *chart, float value) {
+    chart_column_t *col = &chart->pending;
+    if (!isnan(value)) { /* NaN leaves a gap */
+        if (!col->valid || value < col->min)
+            col->min = value;
+        if (!col->valid || value > col->max)
+            col->max = value;
+        col->last = value;
+        col->valid = true;
+    }
+    if (++chart->pending_samples < chart->decimation)
+        return;
+    chart->ring[chart->ring_head] = *col;
+    chart->ring_head = (chart->ring_head + 1) % chart->ring_size;
+    if (chart->ring_count < chart->ring_size)
+        chart->ring_count++;
+    memset(col, 0, sizeof(chart_column_t));
+    chart->pending_samples = 0;
+    const canvas_t c = display_canvas(chart->disp);
+    if (draw_scroll(&c, chart->plot_x, chart->y, chart->plot_w, chart->h, -1, 0, chart->bg) == 0)
+        chart_column(chart, chart->plot_w - 1, 0);
+    else
+        chart_plot(chart);
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
 
+/* Retained widgets: setters store state and mark a widget invalid only when it actually changes; st7735_ui_render
+ * then draws the invalid ones in a single pass. Text is drawn once with its background and only the margins around it
+ * are filled; later text changes redraw only the glyph cells that differ. Progress bars redraw just the strip between
+ * the old and new fill. */
+
+#define WIDGET_TEXT_MAX 64
+
+typedef enum { WIDGET_LABEL, WIDGET_BADGE, WIDGET_VALUE, WIDGET_PROGRESS, WIDGET_STATUSBAR } widget_type_t;
+
+struct st7735_widget {
+    struct st7735_widget *next;
+    widget_type_t type;
+    int x, y, w, h;
+    uint16_t fg, bg;
+    int align, padding, spacing;
 #ifdef ST7735_EXTERNAL_FONTS
+    const fontinfo_t *font;
+    bool mono;
+#endif
+    char text[WIDGET_TEXT_MAX];
+    char drawn[WIDGET_TEXT_MAX]; /* text on screen and the x of each glyph cell, when drawn_valid */
+    int16_t drawn_x[WIDGET_TEXT_MAX];
+    int drawn_start, drawn_end;
+    bool drawn_valid;
+    char format[16]; /* value readouts */
+    float value;     /* progress fraction */
+    int fill_drawn;  /* progress pixels drawn, -1 if the bar needs a full redraw */
+    bool invalid;
+};
 
-int st7735_char_font(st7735_t *disp, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, char c) {
-    if (!font || !font->data)
-        return 0;
-    if (c < font->base || c > font->limit)
-        c = '?';
-    const int char_height = (font->height + 7) / 8;
-    const int char_offs = ((font->width * char_height) + 1) * (c - font->base);
-    const int char_width = mono ? font->width : (int)font->data[char_offs];
-    for (int i = 0; i < char_width; i++) {
-        for (int j = 0; j < char_height; j++) {
-            const uint8_t char_byte = font->data[(char_offs + 1) + (i * char_height) + j];
-            for (int k = 0; k < 8; k++) {
-                if ((j * 8) + k >= font->height)
-                    break;
-                st7735_pixel(disp, x + i, y + (j * 8) + k, (char_byte & (1 << k)) ? fg : bg);
-            }
+struct st7735_ui {
+    st7735_t *disp;
+    st7735_widget_t *widgets, *last;
+};
+
+st7735_ui_t *st7735_ui_create(st7735_t *disp) {
+    st7735_ui_t *ui = calloc(1, sizeof(st7735_ui_t));
+    if (!ui) {
+        perror("calloc");
+        return NULL;
+    }
+    ui->disp = disp;
+    return ui;
+}
+
+void st7735_ui_destroy(st7735_ui_t *ui) {
+    if (!ui)
+        return;
+    for (st7735_widget_t *w = ui->widgets, *next; w; w = next) {
+        next = w->next;
+        free(w);
+    }
+    free(ui);
+}
+
+void st7735_ui_invalidate(st7735_ui_t *ui) {
+    for (st7735_widget_t *w = ui->widgets; w; w = w->next) {
+        w->invalid = true;
+        w->drawn_valid = false;
+        w->fill_drawn = -1;
+    }
+}
+
+static st7735_widget_t *widget_create(st7735_ui_t *ui, widget_type_t type, int x, int y, int w, int h, uint16_t fg, uint16_t bg) {
+    if (w <= 0 || h <= 0)
+        return NULL;
+    st7735_widget_t *widget = calloc(1, sizeof(st7735_widget_t));
+    if (!widget) {
+        perror("calloc");
+        return NULL;
+    }
+    widget->type = type;
+    widget->x = x;
+    widget->y = y;
+    widget->w = w;
+    widget->h = h;
+    widget->fg = fg;
+    widget->bg = bg;
+    widget->align = type == WIDGET_BADGE ? ST7735_ALIGN_CENTER : type == WIDGET_VALUE ? ST7735_ALIGN_RIGHT : ST7735_ALIGN_LEFT;
+    widget->padding = type == WIDGET_STATUSBAR ? 4 : 0;
+    widget->spacing = type == WIDGET_BADGE ? 0 : 1;
+    widget->fill_drawn = -1;
+    widget->invalid = true;
+    if (ui->last)
+        ui->last->next = widget;
+    else
+        ui->widgets = widget;
+    ui->last = widget;
+    return widget;
+}
+
+st7735_widget_t *st7735_label_create(st7735_ui_t *ui, int x, int y, int w, int h, uint16_t fg, uint16_t bg) {
+    return widget_create(ui, WIDGET_LABEL, x, y, w, h, fg, bg);
+}
+st7735_widget_t *st7735_badge_create(st7735_ui_t *ui, int x, int y, int w, int h, uint16_t fg, uint16_t bg) {
+    return widget_create(ui, WIDGET_BADGE, x, y, w, h, fg, bg);
+}
+/* The format is passed a double: it must hold exactly one %f, %e or %g conversion (any case), with optional flags,
+ * width and precision, and otherwise only text and %%. Checked once here, so set_value can hand it to snprintf. */
+static bool value_format_valid(const char *format) {
+    int conversions = 0;
+    for (const char *p = format; *p; p++) {
+        if (*p != '%')
+            continue;
+        if (*++p == '%')
+            continue;
+        p += strspn(p, "-+ #0");
+        p += strspn(p, "0123456789");
+        if (*p == '.') {
+            p++;
+            p += strspn(p, "0123456789");
         }
+        if (!*p || !strchr("fFeEgG", *p))
+            return false;
+        conversions++;
     }
-    return char_width;
+    return conversions == 1;
 }
 
-int st7735_text_font(st7735_t *disp, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, int spacing, const char *str) {
-    if (!font || !font->data || !str)
-        return 0;
-    const int x_start = x;
-    const int char_height = (font->height + 7) / 8;
-    while (*str) {
-        x += st7735_char_font(disp, x, y, fg, bg, font, mono, *str++);
-        x += st7735_char_space(disp, x, y, bg, char_height, spacing);
+st7735_widget_t *st7735_value_create(st7735_ui_t *ui, int x, int y, int w, int h, uint16_t fg, uint16_t bg, const char *format) {
+    st7735_widget_t *widget = widget_create(ui, WIDGET_VALUE, x, y, w, h, fg, bg);
+    if (!widget)
+        return NULL;
+    if (!format || strlen(format) >= sizeof(widget->format) || !value_format_valid(format))
+        format = "%.1f";
+    snprintf(widget->format, sizeof(widget->format), "%s", format);
+    return widget;
+}
+st7735_widget_t *st7735_progress_create(st7735_ui_t *ui, int x, int y, int w, int h, uint16_t fg, uint16_t bg) {
+    return widget_create(ui, WIDGET_PROGRESS, x, y, w, h, fg, bg);
+}
+st7735_widget_t *st7735_statusbar_create(st7735_ui_t *ui, int y, int h, uint16_t fg, uint16_t bg) {
+    return widget_create(ui, WIDGET_STATUSBAR, 0, y, ui->disp->width, h, fg, bg);
+}
+
+void st7735_widget_set_text(st7735_widget_t *widget, const char *text) {
+    if (strncmp(widget->text, text, sizeof(widget->text) - 1) == 0)
+        return;
+    snprintf(widget->text, sizeof(widget->text), "%s", text);
+    widget->invalid = true;
+}
+
+void st7735_widget_printf(st7735_widget_t *widget, const char *fmt, ...) {
+    char text[WIDGET_TEXT_MAX];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    st7735_widget_set_text(widget, text);
+}
+
+static int widget_fill(const st7735_widget_t *widget) {
+    return (int)(widget->value * (float)widget->w + 0.5f);
+}
+
+void st7735_widget_set_value(st7735_widget_t *widget, float value) {
+    if (widget->type == WIDGET_PROGRESS) {
+        widget->value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+        if (widget_fill(widget) != widget->fill_drawn)
+            widget->invalid = true;
+        return;
     }
-    return x - x_start;
+    char text[WIDGET_TEXT_MAX];
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral" /* checked by value_format_valid */
+    snprintf(text, sizeof(text), widget->format, (double)value);
+#pragma GCC diagnostic pop
+    st7735_widget_set_text(widget, text);
+}
+
+void st7735_widget_set_colors(st7735_widget_t *widget, uint16_t fg, uint16_t bg) {
+    if (widget->fg == fg && widget->bg == bg)
+        return;
+    widget->fg = fg;
+    widget->bg = bg;
+    widget->invalid = true;
+    widget->drawn_valid = false;
+    widget->fill_drawn = -1;
+}
+
+void st7735_widget_set_align(st7735_widget_t *widget, int align, int padding) {
+    if (widget->align == align && widget->padding == padding)
+        return;
+    widget->align = align;
+    widget->padding = padding;
+    widget->invalid = true;
+    widget->drawn_valid = false;
 }
 
+#ifdef ST7735_EXTERNAL_FONTS
+void st7735_widget_set_font(st7735_widget_t *widget, const fontinfo_t *font, bool mono) {
+    widget->font = font && font->data ? font : NULL;
+    widget->mono = mono;
+    widget->invalid = true;
+    widget->drawn_valid = false;
+}
 #endif
 
-// ------------------------------------------------------------------------------------------------------------------------
-// ------------------------------------------------------------------------------------------------------------------------
+static int widget_advance(const st7735_widget_t *widget, char ch) {
+#ifdef ST7735_EXTERNAL_FONTS
+    if (widget->font)
+        return font_glyph_width(widget->font, widget->mono, ch) + widget->spacing;
+#endif
+    (void)ch;
+    return 5 + widget->spacing;
+}
 
-void st7735_scroll_setup(st7735_t *disp, int top_fixed, int scroll_area, int bottom_fixed) {
-    const uint8_t data[6] = { (uint8_t)(top_fixed >> 8),     (uint8_t)(top_fixed & 0xFF),  (uint8_t)(scroll_area >> 8),
-                              (uint8_t)(scroll_area & 0xFF), (uint8_t)(bottom_fixed >> 8), (uint8_t)(bottom_fixed & 0xFF) };
-    cmd(disp, ST7735_VSCRDEF);
-    dat_buf(disp, data, sizeof(data));
+static int widget_text_height(const st7735_widget_t *widget) {
+#ifdef ST7735_EXTERNAL_FONTS
+    if (widget->font)
+        return widget->font->height;
+#endif
+    return 7;
 }
 
-void st7735_scroll(st7735_t *disp, int line) {
-    const uint8_t data[2] = { (uint8_t)(line >> 8), (uint8_t)(line & 0xFF) };
-    cmd(disp, ST7735_VSCRSADD);
-    dat_buf(disp, data, sizeof(data));
+/* One glyph cell: the glyph and its spacing column */
+static void widget_draw_glyph(const st7735_widget_t *widget, const canvas_t *c, int x, int y, char ch) {
+    const int h = widget_text_height(widget);
+#ifdef ST7735_EXTERNAL_FONTS
+    if (widget->font) {
+        x += draw_char_font(c, x, y, widget->fg, widget->bg, widget->font, widget->mono, ch);
+        canvas_rect(c, x, y, widget->spacing, h, widget->bg);
+        return;
+    }
+#endif
+    x += draw_char(c, x, y, widget->fg, widget->bg, ch);
+    canvas_rect(c, x, y, widget->spacing, h, widget->bg);
+}
+
+/* Lay out the text and draw it. After a first full draw only glyph cells whose character or x position changed are
+ * redrawn, matching old and new cells by position so glyphs shifted by a variable-width change are caught, and the
+ * part of the old text span left uncovered is cleared. */
+static void widget_draw_text(st7735_widget_t *widget, const canvas_t *c) {
+    const int x = widget->x, y = widget->y, w = widget->w, h = widget->h;
+    const int len = (int)strlen(widget->text), th = widget_text_height(widget);
+    int16_t xs[WIDGET_TEXT_MAX];
+    int tw = 0;
+    for (int i = 0; i < len; i++) {
+        xs[i] = (int16_t)tw;
+        tw += widget_advance(widget, widget->text[i]);
+    }
+    const int tx = widget->align == ST7735_ALIGN_CENTER ? x + (w - tw) / 2 : widget->align == ST7735_ALIGN_RIGHT ? x + w - widget->padding - tw : x + widget->padding;
+    const int ty = y + (h - th) / 2;
+    for (int i = 0; i < len; i++)
+        xs[i] = (int16_t)(xs[i] + tx);
+
+    if (!widget->drawn_valid || widget->spacing < 0) { /* overlapping cells can't be diffed */
+        canvas_rect(c, x, y, w, ty - y, widget->bg);
+        canvas_rect(c, x, ty + th, w, y + h - ty - th, widget->bg);
+        canvas_rect(c, x, ty, tx - x, th, widget->bg);
+        canvas_rect(c, tx + tw, ty, x + w - tx - tw, th, widget->bg);
+        for (int i = 0; i < len; i++)
+            widget_draw_glyph(widget, c, xs[i], ty, widget->text[i]);
+    } else {
+        if (widget->drawn_start < tx)
+            canvas_rect(c, widget->drawn_start, ty, tx - widget->drawn_start, th, widget->bg);
+        if (widget->drawn_end > tx + tw)
+            canvas_rect(c, tx + tw, ty, widget->drawn_end - tx - tw, th, widget->bg);
+        for (int i = 0, j = 0; i < len; i++) {
+            while (widget->drawn[j] && widget->drawn_x[j] < xs[i])
+                j++;
+            if (widget->drawn[j] != widget->text[i] || widget->drawn_x[j] != xs[i])
+                widget_draw_glyph(widget, c, xs[i], ty, widget->text[i]);
+        }
+    }
+    memcpy(widget->drawn, widget->text, (size_t)len + 1);
+    memcpy(widget->drawn_x, xs, (size_t)len * sizeof(int16_t));
+    widget->drawn_start = tx;
+    widget->drawn_end = tx + tw;
+    widget->drawn_valid = true;
+}
+
+static void widget_draw_progress(st7735_widget_t *widget, const canvas_t *c) {
+    const int fill = widget_fill(widget);
+    if (widget->fill_drawn < 0) {
+        canvas_rect(c, widget->x, widget->y, fill, widget->h, widget->fg);
+        canvas_rect(c, widget->x + fill, widget->y, widget->w - fill, widget->h, widget->bg);
+    } else if (fill > widget->fill_drawn)
+        canvas_rect(c, widget->x + widget->fill_drawn, widget->y, fill - widget->fill_drawn, widget->h, widget->fg);
+    else if (fill < widget->fill_drawn)
+        canvas_rect(c, widget->x + fill, widget->y, widget->fill_drawn - fill, widget->h, widget->bg);
+    widget->fill_drawn = fill;
+}
+
+int st7735_ui_render(st7735_ui_t *ui) {
+    int drawn = 0;
+    for (st7735_widget_t *widget = ui->widgets; widget; widget = widget->next) {
+        if (!widget->invalid)
+            continue;
+        canvas_t c = display_canvas(ui->disp);
+        canvas_restrict(&c, widget->x, widget->y, widget->x + widget->w - 1, widget->y + widget->h - 1);
+        if (widget->type == WIDGET_PROGRESS)
+            widget_draw_progress(widget, &c);
+        else
+            widget_draw_text(widget, &c);
+        widget->invalid = false;
+        drawn++;
+    }
+    return drawn;
 }
 
 // ------------------------------------------------------------------------------------------------------------------------
@@ -711,35 +4246,39 @@ static int __bmp_parse(const uint8_t *data, size_t len, int *w, int *h, const ui
         return -1;
     return 0;
 }
-static int load_bmp_data(st7735_t *disp, int x, int y, const uint8_t *data, size_t len) {
+static st7735_surface_t *decode_bmp_data(const uint8_t *data, size_t len) {
     int w, h, stride, bottom_up;
     const uint8_t *pixels;
     if (__bmp_parse(data, len, &w, &h, &pixels, &stride, &bottom_up) != 0)
-        return -1;
+        return NULL;
+    st7735_surface_t *surface = st7735_surface_create(w, h);
+    if (!surface)
+        return NULL;
     for (int py = 0; py < h; py++) {
         const uint8_t *row = pixels + (bottom_up ? (h - 1 - py) : py) * stride;
+        uint16_t *dst = surface->pixels + py * surface->stride;
         for (int px = 0; px < w; px++)
-            st7735_pixel(disp, x + px, y + py, RGB565(row[px * 3 + 2], row[px * 3 + 1], row[px * 3 + 0]));
+            dst[px] = (uint16_t)RGB565(row[px * 3 + 2], row[px * 3 + 1], row[px * 3 + 0]);
     }
-    return 0;
+    return surface;
 }
-static int load_bmp_file(st7735_t *disp, int x, int y, const char *filename) {
+static st7735_surface_t *decode_bmp_file(const char *filename) {
     FILE *fp = fopen(filename, "rb");
     if (!fp)
-        return -1;
+        return NULL;
     fseek(fp, 0, SEEK_END);
     size_t len = (size_t)ftell(fp);
     fseek(fp, 0, SEEK_SET);
     uint8_t *data = malloc(len);
     if (!data) {
         fclose(fp);
-        return -1;
+        return NULL;
     }
     fread(data, 1, len, fp);
     fclose(fp);
-    const int result = load_bmp_data(disp, x, y, data, len);
+    st7735_surface_t *surface = decode_bmp_data(data, len);
     free(data);
-    return result;
+    return surface;
 }
 #endif
 
@@ -749,40 +4288,43 @@ static void __png_image_setup(png_image *image) {
     memset(image, 0, sizeof(png_image));
     image->version = PNG_IMAGE_VERSION;
 }
-static int __png_image_render(st7735_t *disp, int x, int y, png_image *image) {
+static st7735_surface_t *__png_image_decode(png_image *image) {
     image->format = PNG_FORMAT_RGB;
     uint8_t *buffer = malloc(PNG_IMAGE_SIZE(*image));
     if (!buffer) {
         png_image_free(image);
-        return -1;
+        return NULL;
     }
     if (!png_image_finish_read(image, NULL, buffer, 0, NULL)) {
         free(buffer);
         png_image_free(image);
-        return -1;
+        return NULL;
     }
-    for (int py = 0; py < (int)image->height; py++)
-        for (int px = 0; px < (int)image->width; px++) {
-            const int idx = (py * (int)image->width + px) * 3;
-            st7735_pixel(disp, x + px, y + py, RGB565(buffer[idx], buffer[idx + 1], buffer[idx + 2]));
+    st7735_surface_t *surface = st7735_surface_create((int)image->width, (int)image->height);
+    if (surface)
+        for (int py = 0; py < surface->height; py++) {
+            const uint8_t *row = buffer + py * surface->width * 3;
+            uint16_t *dst = surface->pixels + py * surface->stride;
+            for (int px = 0; px < surface->width; px++)
+                dst[px] = (uint16_t)RGB565(row[px * 3], row[px * 3 + 1], row[px * 3 + 2]);
         }
     free(buffer);
     png_image_free(image);
-    return 0;
+    return surface;
 }
-static int load_png_data(st7735_t *disp, int x, int y, const uint8_t *data, size_t len) {
+static st7735_surface_t *decode_png_data(const uint8_t *data, size_t len) {
     png_image image;
     __png_image_setup(&image);
     if (!png_image_begin_read_from_memory(&image, data, len))
-        return -1;
-    return __png_image_render(disp, x, y, &image);
+        return NULL;
+    return __png_image_decode(&image);
 }
-static int load_png_file(st7735_t *disp, int x, int y, const char *filename) {
+static st7735_surface_t *decode_png_file(const char *filename) {
     png_image image;
     __png_image_setup(&image);
     if (!png_image_begin_read_from_file(&image, filename))
-        return -1;
-    return __png_image_render(disp, x, y, &image);
+        return NULL;
+    return __png_image_decode(&image);
 }
 #endif
 
@@ -792,6 +4334,8 @@ static int load_png_file(st7735_t *disp, int x, int y, const char *filename) {
 struct jpg_error_mgr {
     struct jpeg_error_mgr pub;
     jmp_buf setjmp_buffer;
+    st7735_surface_t *surface; /* released if decoding fails part way */
+    uint8_t *row;
 };
 static void jpg_error_exit(j_common_ptr cinfo) {
     longjmp(((struct jpg_error_mgr *)cinfo->err)->setjmp_buffer, 1);
@@ -799,55 +4343,62 @@ static void jpg_error_exit(j_common_ptr cinfo) {
 #define __jpg_image_setup(cinfo, jerr)                                                                                                                         \
     (cinfo)->err = jpeg_std_error(&((jerr)->pub));                                                                                                             \
     (jerr)->pub.error_exit = jpg_error_exit;                                                                                                                   \
+    (jerr)->surface = NULL;                                                                                                                                    \
+    (jerr)->row = NULL;                                                                                                                                        \
     if (setjmp((jerr)->setjmp_buffer)) {                                                                                                                       \
+        free((jerr)->row);                                                                                                                                     \
+        st7735_surface_destroy((jerr)->surface);                                                                                                               \
         jpeg_destroy_decompress(cinfo);                                                                                                                        \
-        return -1;                                                                                                                                             \
+        return NULL;                                                                                                                                           \
     }
-static int __jpg_image_render(st7735_t *disp, int x, int y, struct jpeg_decompress_struct *cinfo) {
+static st7735_surface_t *__jpg_image_decode(struct jpeg_decompress_struct *cinfo, struct jpg_error_mgr *jerr) {
     jpeg_read_header(cinfo, TRUE);
     cinfo->out_color_space = JCS_RGB;
     jpeg_start_decompress(cinfo);
-    uint8_t *row = malloc(cinfo->output_width * 3);
-    if (!row) {
+    jerr->surface = st7735_surface_create((int)cinfo->output_width, (int)cinfo->output_height);
+    jerr->row = malloc(cinfo->output_width * 3);
+    if (!jerr->surface || !jerr->row) {
+        free(jerr->row);
+        st7735_surface_destroy(jerr->surface);
         jpeg_destroy_decompress(cinfo);
-        return -1;
+        return NULL;
     }
-    int py = 0;
     while (cinfo->output_scanline < cinfo->output_height) {
-        jpeg_read_scanlines(cinfo, &row, 1);
+        uint16_t *dst = jerr->surface->pixels + (int)cinfo->output_scanline * jerr->surface->stride;
+        jpeg_read_scanlines(cinfo, &jerr->row, 1);
         for (int px = 0; px < (int)cinfo->output_width; px++)
-            st7735_pixel(disp, x + px, y + py, RGB565(row[px * 3], row[px * 3 + 1], row[px * 3 + 2]));
-        py++;
+            dst[px] = (uint16_t)RGB565(jerr->row[px * 3], jerr->row[px * 3 + 1], jerr->row[px * 3 + 2]);
     }
-    free(row);
+    free(jerr->row);
+    jerr->row = NULL; /* finish can still fail into the handler, which frees it */
     jpeg_finish_decompress(cinfo);
     jpeg_destroy_decompress(cinfo);
-    return 0;
+    return jerr->surface;
 }
-static int load_jpg_data(st7735_t *disp, int x, int y, const uint8_t *data, size_t len) {
+static st7735_surface_t *decode_jpg_data(const uint8_t *data, size_t len) {
     struct jpeg_decompress_struct cinfo;
     struct jpg_error_mgr jerr;
     __jpg_image_setup(&cinfo, &jerr);
     jpeg_create_decompress(&cinfo);
     jpeg_mem_src(&cinfo, data, len);
-    return __jpg_image_render(disp, x, y, &cinfo);
+    return __jpg_image_decode(&cinfo, &jerr);
 }
-static int load_jpg_file(st7735_t *disp, int x, int y, const char *filename) {
+static st7735_surface_t *decode_jpg_file(const char *filename) {
     struct jpeg_decompress_struct cinfo;
     struct jpg_error_mgr jerr;
     __jpg_image_setup(&cinfo, &jerr);
     FILE *fp = fopen(filename, "rb");
     if (!fp)
-        return -1;
+        return NULL;
     jpeg_create_decompress(&cinfo);
     jpeg_stdio_src(&cinfo, fp);
-    const int ret = __jpg_image_render(disp, x, y, &cinfo);
+    st7735_surface_t *surface = __jpg_image_decode(&cinfo, &jerr);
     fclose(fp);
-    return ret;
+    return surface;
 }
 #endif
 
-int st7735_image(st7735_t *disp, int x, int y, const char *data, int size, int format, int encoding) {
+st7735_surface_t *st7735_image_decode(const char *data, int size, int format, int encoding) {
     const uint8_t *img_buf;
     size_t img_len;
 #if defined(ST7735_IMAGE_SUPPORT_BASE64)
@@ -859,7 +4410,7 @@ int st7735_image(st7735_t *disp, int x, int y, const char *data, int size, int f
     case ST7735_IMAGE_ENCODING_BASE64:
         decoded = decode_base64(data, &img_len);
         if (!decoded)
-            return -1;
+            return NULL;
         img_buf = decoded;
         break;
 #endif
@@ -868,53 +4419,275 @@ int st7735_image(st7735_t *disp, int x, int y, const char *data, int size, int f
         img_len = (size_t)size;
         break;
     default:
-        return -1;
+        return NULL;
     }
 
-    int result = -1;
+    st7735_surface_t *surface = NULL;
     switch (format) {
 #ifdef ST7735_IMAGE_SUPPORT_BMP
     case ST7735_IMAGE_FORMAT_BMP:
-        result = load_bmp_data(disp, x, y, img_buf, img_len);
+        surface = decode_bmp_data(img_buf, img_len);
         break;
 #endif
 #ifdef ST7735_IMAGE_SUPPORT_PNG
     case ST7735_IMAGE_FORMAT_PNG:
-        result = load_png_data(disp, x, y, img_buf, img_len);
+        surface = decode_png_data(img_buf, img_len);
         break;
 #endif
 #ifdef ST7735_IMAGE_SUPPORT_JPG
     case ST7735_IMAGE_FORMAT_JPG:
-        result = load_jpg_data(disp, x, y, img_buf, img_len);
+        surface = decode_jpg_data(img_buf, img_len);
         break;
 #endif
     default:
-        result = -1;
+        surface = NULL;
     }
 #if defined(ST7735_IMAGE_SUPPORT_BASE64)
     if (decoded)
         free(decoded);
 #endif
-    return result;
+    return surface;
 }
 
-int st7735_image_file(st7735_t *disp, int x, int y, const char *filename) {
+st7735_surface_t *st7735_image_decode_file(const char *filename) {
     const char *ext = strrchr(filename, '.');
     if (!ext)
-        return -1;
+        return NULL;
 #ifdef ST7735_IMAGE_SUPPORT_BMP
     if (strcasecmp(ext, ".bmp") == 0)
-        return load_bmp_file(disp, x, y, filename);
+        return decode_bmp_file(filename);
 #endif
 #ifdef ST7735_IMAGE_SUPPORT_PNG
     else if (strcasecmp(ext, ".png") == 0)
-        return load_png_file(disp, x, y, filename);
+        return decode_png_file(filename);
 #endif
 #ifdef ST7735_IMAGE_SUPPORT_JPG
     else if (strcasecmp(ext, ".jpg") == 0 || strcasecmp(ext, ".jpeg") == 0)
-        return load_jpg_file(disp, x, y, filename);
+        return decode_jpg_file(filename);
 #endif
-    return -1;
+    return NULL;
+}
+
+static int draw_image(const canvas_t *c, int x, int y, st7735_surface_t *surface) {
+    if (!surface)
+        return -1;
+    draw_blit(c, x, y, surface);
+    st7735_surface_destroy(surface);
+    return 0;
+}
+
+int st7735_image(st7735_t *disp, int x, int y, const char *data, int size, int format, int encoding) {
+    const canvas_t c = view_canvas(disp);
+    return draw_image(&c, x, y, st7735_image_decode(data, size, format, encoding));
+}
+int st7735_surface_image(st7735_surface_t *dst, int x, int y, const char *data, int size, int format, int encoding) {
+    const canvas_t c = surface_canvas(dst);
+    return draw_image(&c, x, y, st7735_image_decode(data, size, format, encoding));
+}
+
+int st7735_image_file(st7735_t *disp, int x, int y, const char *filename) {
+    const canvas_t c = view_canvas(disp);
+    return draw_image(&c, x, y, st7735_image_decode_file(filename));
+}
+int st7735_surface_image_file(st7735_surface_t *dst, int x, int y, const char *filename) {
+    const canvas_t c = surface_canvas(dst);
+    return draw_image(&c, x, y, st7735_image_decode_file(filename));
+}
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+typedef enum { PREFETCH_QUEUED, PREFETCH_RUNNING, PREFETCH_DONE } prefetch_state_t;
+
+struct st7735_prefetch_job {
+    st7735_prefetch_job_t *next;
+    st7735_prefetch_t *pool;
+    prefetch_state_t state;
+    bool released;
+    char *filename;
+    const char *data;
+    int size, format, encoding;
+    st7735_surface_t *surface;
+};
+
+struct st7735_prefetch {
+    pthread_mutex_t lock;
+    pthread_cond_t queued;
+    pthread_cond_t finished;
+    st7735_prefetch_job_t *head, *tail;
+    pthread_t *threads;
+    int workers;
+    bool stopping;
+};
+
+static void prefetch_job_free(st7735_prefetch_job_t *job) {
+    st7735_surface_destroy(job->surface);
+    free(job->filename);
+    free(job);
+}
+
+static void *prefetch_worker(void *arg) {
+    st7735_prefetch_t *pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (!pool->head && !pool->stopping)
+            pthread_cond_wait(&pool->queued, &pool->lock);
+        if (pool->stopping)
+            break;
+        st7735_prefetch_job_t *job = pool->head;
+        pool->head = job->next;
+        if (!pool->head)
+            pool->tail = NULL;
+        job->state = PREFETCH_RUNNING;
+        pthread_mutex_unlock(&pool->lock);
+        st7735_surface_t *surface =
+            job->filename ? st7735_image_decode_file(job->filename) : st7735_image_decode(job->data, job->size, job->format, job->encoding);
+        pthread_mutex_lock(&pool->lock);
+        job->surface = surface;
+        job->state = PREFETCH_DONE;
+        if (job->released)
+            prefetch_job_free(job);
+        else
+            pthread_cond_broadcast(&pool->finished);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+st7735_prefetch_t *st7735_prefetch_create(int workers) {
+    if (workers <= 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 1 ? (int)cpus - 1 : 1; /* leave one core for the caller */
+    }
+    st7735_prefetch_t *pool = calloc(1, sizeof(st7735_prefetch_t));
+    if (!pool) {
+        perror("calloc");
+        return NULL;
+    }
+    pool->threads = calloc((size_t)workers, sizeof(pthread_t));
+    if (!pool->threads) {
+        perror("calloc");
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->queued, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+    for (int i = 0; i < workers; i++) {
+        if (pthread_create(&pool->threads[i], NULL, prefetch_worker, pool) != 0) {
+            perror("pthread_create");
+            break;
+        }
+        pool->workers++;
+    }
+    if (pool->workers == 0) {
+        st7735_prefetch_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void st7735_prefetch_destroy(st7735_prefetch_t *pool) {
+    if (!pool)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    /* jobs that never started complete with no surface */
+    for (st7735_prefetch_job_t *job = pool->head; job; job = job->next)
+        job->state = PREFETCH_DONE;
+    pool->head = pool->tail = NULL;
+    pthread_cond_broadcast(&pool->queued);
+    pthread_cond_broadcast(&pool->finished);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->workers; i++)
+        pthread_join(pool->threads[i], NULL);
+    pthread_cond_destroy(&pool->finished);
+    pthread_cond_destroy(&pool->queued);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
+
+static st7735_prefetch_job_t *prefetch_enqueue(st7735_prefetch_t *pool, st7735_prefetch_job_t *job) {
+    pthread_mutex_lock(&pool->lock);
+    job->pool = pool;
+    job->state = PREFETCH_QUEUED;
+    if (pool->tail)
+        pool->tail->next = job;
+    else
+        pool->head = job;
+    pool->tail = job;
+    pthread_cond_signal(&pool->queued);
+    pthread_mutex_unlock(&pool->lock);
+    return job;
+}
+
+st7735_prefetch_job_t *st7735_prefetch_image(st7735_prefetch_t *pool, const char *data, int size, int format, int encoding) {
+    st7735_prefetch_job_t *job = calloc(1, sizeof(st7735_prefetch_job_t));
+    if (!job) {
+        perror("calloc");
+        return NULL;
+    }
+    job->data = data;
+    job->size = size;
+    job->format = format;
+    job->encoding = encoding;
+    return prefetch_enqueue(pool, job);
+}
+
+st7735_prefetch_job_t *st7735_prefetch_image_file(st7735_prefetch_t *pool, const char *filename) {
+    st7735_prefetch_job_t *job = calloc(1, sizeof(st7735_prefetch_job_t));
+    if (!job) {
+        perror("calloc");
+        return NULL;
+    }
+    job->filename = strdup(filename);
+    if (!job->filename) {
+        perror("strdup");
+        free(job);
+        return NULL;
+    }
+    return prefetch_enqueue(pool, job);
+}
+
+bool st7735_prefetch_ready(const st7735_prefetch_job_t *job) {
+    st7735_prefetch_t *pool = job->pool;
+    pthread_mutex_lock(&pool->lock);
+    const bool ready = job->state == PREFETCH_DONE;
+    pthread_mutex_unlock(&pool->lock);
+    return ready;
+}
+
+st7735_surface_t *st7735_prefetch_wait(st7735_prefetch_job_t *job) {
+    st7735_prefetch_t *pool = job->pool;
+    pthread_mutex_lock(&pool->lock);
+    while (job->state != PREFETCH_DONE)
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    st7735_surface_t *surface = job->surface;
+    pthread_mutex_unlock(&pool->lock);
+    return surface;
+}
+
+void st7735_prefetch_release(st7735_prefetch_job_t *job) {
+    if (!job)
+        return;
+    st7735_prefetch_t *pool = job->pool;
+    pthread_mutex_lock(&pool->lock);
+    if (job->state == PREFETCH_RUNNING) {
+        job->released = true; /* worker frees it when the decode finishes */
+        job = NULL;
+    } else if (job->state == PREFETCH_QUEUED) {
+        st7735_prefetch_job_t **link = &pool->head, *prev = NULL;
+        while (*link != job) {
+            prev = *link;
+            link = &(*link)->next;
+        }
+        *link = job->next;
+        if (pool->tail == job)
+            pool->tail = prev;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (job)
+        prefetch_job_free(job);
 }
 
 #endif
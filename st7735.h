@@ -34,10 +34,40 @@ typedef struct st7735 st7735_t;
 #define ST7735_ROTATION_180 180
 #define ST7735_ROTATION_270 270
 
+/* RGB565 pixel storage that drawing functions can target (stride in pixels) */
+typedef struct {
+    uint16_t *pixels;
+    int width, height;
+    int stride;
+} st7735_surface_t;
+
+/* Polygon vertex */
+typedef struct {
+    int x, y;
+} st7735_point_t;
+
 // ------------------------------------------------------------------------------------------------------------------------
 
+/* SPI clocks: pixel data tolerates a faster clock than the init sequence and other commands. Panels usually take
+ * 24-32 MHz for writes; the defaults are the conservative 16 MHz for both. */
+#define ST7735_SPEED_DEFAULT     16000000
+#define ST7735_CMD_SPEED_DEFAULT 16000000
+
+/* The Automation HAT Mini panel sits on CE1; a second panel on CE0 would be /dev/spidev0.0 */
+#define ST7735_SPI_DEVICE "/dev/spidev0.1"
+
+typedef struct {
+    const char *spi_dev; /* NULL for ST7735_SPI_DEVICE */
+    int pin_dc, pin_bl;
+    int rotation;
+    uint32_t speed_hz;     /* pixel data clock, 0 for ST7735_SPEED_DEFAULT */
+    uint32_t cmd_speed_hz; /* command clock, 0 for ST7735_CMD_SPEED_DEFAULT */
+    int color_depth;       /* interface bits per pixel, 12 or 16 (0) as st7735_set_color_depth */
+} st7735_config_t;
+
 /* Initialize display. Returns NULL on failure. */
 st7735_t *st7735_init(int dc_pin, int bl_pin, int rotation);
+st7735_t *st7735_init_ex(const st7735_config_t *config);
 
 /* Close and free resources */
 void st7735_close(st7735_t *disp);
@@ -54,10 +84,153 @@ void st7735_set_buffered(st7735_t *disp, bool enabled);
 bool st7735_is_buffered(const st7735_t *disp);
 void st7735_flush(st7735_t *disp);
 
+/* Frame pacing: with a target rate, st7735_flush only sends when a frame period has passed since the last frame and
+ * otherwise leaves the region dirty, so bursts of updates coalesce into one transfer per period. Nothing sends a held
+ * update by itself: it goes out with the next st7735_flush after the deadline or with st7735_frame, so a burst must end
+ * with st7735_frame (st7735_frame_pending tells whether one is needed). A queue owner thread does this itself.
+ * st7735_frame is the loop form: it sleeps until the next deadline, flushes,
+ * and returns how many deadlines were missed since the previous frame (the cadence resumes from now, without catching
+ * up). panel also programs the panel's own refresh (FRMCTR1) to the multiple of fps nearest its 80 Hz default, so the
+ * tear line, without a TE signal to sync to, stays put rather than rolling; fps 0 with panel restores the default.
+ * fps 0 turns pacing off and sends anything held. Returns 0 on success, -1 for fps outside 0-1000. */
+int st7735_set_frame_rate(st7735_t *disp, int fps, bool panel);
+int st7735_frame(st7735_t *disp);
+bool st7735_frame_pending(const st7735_t *disp); /* an update is held back by pacing */
+
+typedef struct {
+    int fps;
+    int panel_centihz;     /* panel refresh from FRMCTR1 in 1/100 Hz, 0 when left at its default */
+    uint64_t frames;       /* paced flushes sent */
+    uint64_t missed;       /* frame periods that passed without st7735_frame */
+    uint64_t coalesced;    /* flushes held back into a later frame */
+    uint32_t late_max_us;  /* worst start of st7735_frame after its deadline */
+    uint32_t flush_max_us; /* worst transfer time of a frame */
+} st7735_frame_stats_t;
+
+/* Counters since pacing was last set */
+void st7735_frame_stats(const st7735_t *disp, st7735_frame_stats_t *stats);
+
+/* Flush latency: every framebuffer transfer is timed into a histogram (12.5% resolution above 8 us), paced or not.
+ * Percentiles are the upper bound of their bucket, capped at the exact maximum. Readable and resettable from any
+ * thread; a reset takes effect for the recording thread at its next flush, and reads show it empty until then. */
+typedef struct {
+    uint64_t count;
+    uint32_t min_us, max_us, mean_us;
+    uint32_t p50_us, p99_us;
+} st7735_latency_t;
+
+void st7735_flush_latency(const st7735_t *disp, st7735_latency_t *latency);
+void st7735_flush_latency_reset(st7735_t *disp);
+
+/* Cost counters since init or the last reset. The transport figures (ioctls, bytes, transfer time) cover everything
+ * sent, commands included; flush time is split into the part inside the SPI ioctls and the rest, which is the CPU cost
+ * of converting pixels for the wire. Counters are updated by the thread that draws and flushes (a queue's owner) and
+ * can be read and reset from any thread: a reset moves a baseline rather than clearing them, so no count in flight is
+ * lost. A read racing a reset uses either the whole old baseline or the whole new one, and a count the reset overtook
+ * reads as 0. st7735_stats_reset also clears the flush latency histogram. */
+typedef struct {
+    uint64_t ioctls;            /* SPI messages */
+    uint64_t bytes;             /* bytes on the bus */
+    uint64_t transfer_us;       /* time inside SPI ioctls */
+    uint64_t commands;          /* command bytes */
+    uint64_t windows;           /* address windows set */
+    uint64_t pixels;            /* pixels written to panel memory: the area of those windows */
+    uint64_t pixel_calls;       /* st7735_pixel calls */
+    uint64_t flushes;           /* st7735_flush calls, including clean and coalesced ones */
+    uint64_t flush_convert_us;  /* flush time outside SPI ioctls */
+    uint64_t flush_transfer_us; /* flush time inside them */
+    st7735_latency_t flush_latency;
+} st7735_stats_t;
+
+void st7735_stats_get(const st7735_t *disp, st7735_stats_t *stats);
+void st7735_stats_reset(st7735_t *disp);
+
+/* Timeline tracing of the flush stages: flush, convert (byte swapping, RGB444 packing, palette expansion into tmpbuf),
+ * window (address setup), spi (pixel data ioctls), render (display list replay) and pace (waiting for a frame
+ * deadline). Each is recorded as it ends, with its start and duration, into a ring of capacity events allocated by
+ * st7735_trace_start; once full the oldest are overwritten. Off, a stage costs a pointer test. Start restarts the ring,
+ * stop keeps it for st7735_trace_dump, which writes it as Chrome trace event JSON (chrome://tracing, Perfetto) and
+ * returns the number of events or -1. Recording is single-threaded: start, stop and dump from the thread that draws,
+ * or while it is idle. st7735_trace_begin / st7735_trace_end add spans of the application's own, e.g. around
+ * immediate-mode drawing; name must outlive the dump, NULL is recorded as "?". */
+int st7735_trace_start(st7735_t *disp, int capacity);
+void st7735_trace_stop(st7735_t *disp);
+int st7735_trace_dump(const st7735_t *disp, const char *path);
+uint64_t st7735_trace_begin(const st7735_t *disp);
+void st7735_trace_end(st7735_t *disp, uint64_t begin, const char *name);
+
+/* Real-time settings for the thread that flushes: SCHED_FIFO at priority (1-99, 0 leaves the policy alone), pinned to
+ * cpu (-1 for any), and with lock_memory every page of the process locked with mlockall, current and future, and the
+ * calling thread's stack prefaulted. The flush path allocates nothing: tmpbuf is sized at init and transfer
+ * descriptors live on the stack. Priority and locking need CAP_SYS_NICE / CAP_IPC_LOCK or matching rlimits.
+ * st7735_set_realtime applies to the calling thread, st7735_queue_set_realtime to a queue's owner thread; both reset
+ * the latency histogram. Return 0 on success, -1 on failure, with any earlier settings left applied. */
+typedef struct {
+    int priority;
+    int cpu;
+    bool lock_memory;
+} st7735_realtime_t;
+
+int st7735_set_realtime(st7735_t *disp, const st7735_realtime_t *rt);
+/* Undoes it for the calling thread: the policy, priority and CPU mask from before the first st7735_set_realtime come
+ * back, and memory is unlocked only if that call locked it (munlockall is process wide). Does nothing if not set. */
+int st7735_clear_realtime(st7735_t *disp);
+
+/* Pixel data as 16 bit SPI words: the controller then sends native RGB565 in panel order, so flushes skip the byte
+ * swap and point the transfers straight at framebuffer rows. On by default when the SPI controller accepts 16 bit
+ * words, else the byte path is used; set_word16 returns -1 if asked for it without that support. */
+int st7735_set_word16(st7735_t *disp, bool enabled);
+bool st7735_is_word16(const st7735_t *disp);
+
+/* Bits per pixel on the wire: 16 (default) or 12, which sends each pixel as RGB444, two in three bytes, cutting a
+ * full frame from 25600 to 19200 bytes. Drawing and the framebuffer stay RGB565; channels are truncated at send. Returns
+ * 0 on success, -1 for other values. */
+int st7735_set_color_depth(st7735_t *disp, int bits);
+int st7735_color_depth(const st7735_t *disp);
+
+/* SPI clocks after init, 0 for the defaults; the controller rounds each down to a divider of its own clock */
+void st7735_set_speed(st7735_t *disp, uint32_t speed_hz, uint32_t cmd_speed_hz);
+uint32_t st7735_speed(const st7735_t *disp);
+
+typedef struct {
+    uint32_t speed_hz;       /* as requested (0 becomes the default); spidev does not report the divider applied */
+    uint32_t bytes_per_sec;  /* measured on the bus, excluding time spent preparing the data */
+    uint32_t usec_per_frame; /* full-screen flush */
+} st7735_speed_probe_t;
+
+/* Measure pixel throughput at each candidate clock by resending the framebuffer frames times per candidate; the
+ * pixel clock is restored afterwards. The panel cannot be read back, so this finds where throughput stops scaling,
+ * not whether the panel latched every pixel: check the image at the chosen speed. Two requests that round to the same
+ * divider show the same bytes_per_sec. Needs buffering. Returns the number of results written (count), -1 on failure
+ * or when speeds or results is NULL or count or frames is not positive. */
+int st7735_probe_speeds(st7735_t *disp, const uint32_t *speeds, int count, int frames, st7735_speed_probe_t *results);
+
+/* Palette framebuffer: 4 or 8 bit indices instead of RGB565, expanded through the palette at flush. Drawing still takes
+ * RGB565 colours, each mapped to the nearest of the count entries. Enabling buffers the display, converting any RGB565
+ * frame; bpp 0 goes back to RGB565 buffering. Changing the palette recolours the whole screen on the next flush without
+ * redrawing. Save-under, scroll regions, alpha blending and st7735_framebuffer need RGB565 buffering and report
+ * failure in this mode, as when unbuffered. Return 0 on success, -1 on failure. */
+int st7735_set_indexed(st7735_t *disp, int bpp, const uint16_t *palette, int count);
+int st7735_set_palette(st7735_t *disp, const uint16_t *palette, int count);
+
+/* Framebuffer as a surface (NULL when unbuffered); mark regions drawn through it with st7735_invalidate */
+st7735_surface_t *st7735_framebuffer(st7735_t *disp);
+void st7735_invalidate(st7735_t *disp, int x, int y, int w, int h);
+
+/* Clip and viewport stack for the drawing calls below (pixel through images and st7735_scroll_region). Coordinates
+ * are relative to the current origin and every push is intersected with the area already in force. clip_push only
+ * narrows the drawable area; viewport_push also moves the origin to x,y, so a widget can draw at 0,0 inside its box.
+ * clip_pop undoes the most recent push of either kind. Retained objects (display lists, consoles, charts, widgets),
+ * save-under and st7735_invalidate keep using screen coordinates. Push/pop return 0 on success, -1 on failure. */
+int st7735_clip_push(st7735_t *disp, int x, int y, int w, int h);
+int st7735_viewport_push(st7735_t *disp, int x, int y, int w, int h);
+int st7735_clip_pop(st7735_t *disp);
+void st7735_clip_reset(st7735_t *disp);
+
 /* Draw single pixel */
 void st7735_pixel(st7735_t *disp, int x, int y, uint16_t color);
 
-/* Fill entire screen with color */
+/* Fill entire screen (the current clip area) with color */
 void st7735_fill(st7735_t *disp, uint16_t color);
 
 /* Draw line */
@@ -75,6 +248,16 @@ void st7735_circle(st7735_t *disp, int x, int y, int r, uint16_t color);
 /* Draw filled circle */
 void st7735_fill_circle(st7735_t *disp, int x, int y, int r, uint16_t color);
 
+/* Filled polygon (even-odd rule) and triangle, rasterised as horizontal spans. Vertices sit on pixel corners, so
+ * 0,0 10,0 10,10 0,10 covers the same pixels as st7735_fill_rect(0, 0, 10, 10) and shapes sharing an edge do not
+ * overlap. */
+void st7735_fill_polygon(st7735_t *disp, const st7735_point_t *points, int count, uint16_t color);
+void st7735_fill_triangle(st7735_t *disp, int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color);
+
+/* Filled ring sector around pixel x,y covering radii r_inner..r_outer (r_inner 0 for a pie slice), from start to end
+ * degrees clockwise with 0 at 3 o'clock; a sweep of 360 or more is a full ring */
+void st7735_fill_arc(st7735_t *disp, int x, int y, int r_outer, int r_inner, int start, int end, uint16_t color);
+
 /* Draw character (built-in 5x7 font) - returns width drawn */
 int st7735_char(st7735_t *disp, int x, int y, uint16_t fg, uint16_t bg, char c);
 
@@ -91,10 +274,227 @@ int st7735_text_font(st7735_t *disp, int x, int y, uint16_t fg, uint16_t bg, con
 
 #endif
 
+/* Copy surface to display at x,y (clipped) */
+void st7735_blit(st7735_t *disp, int x, int y, const st7735_surface_t *surface);
+
+#define ST7735_SCALE_NEAREST 0
+#define ST7735_SCALE_BOX     1 /* area average when shrinking, nearest when enlarging */
+
+/* Draw surface scaled to w x h at x,y */
+void st7735_blit_scaled(st7735_t *disp, int x, int y, int w, int h, const st7735_surface_t *surface, int mode);
+
+/* Draw surface scaled to fit the display, aspect preserved and centred */
+void st7735_blit_fit(st7735_t *disp, const st7735_surface_t *surface, int mode);
+
+/* Draw surface rotated clockwise by ST7735_ROTATION_* at x,y */
+void st7735_blit_rotated(st7735_t *disp, int x, int y, const st7735_surface_t *surface, int rotation);
+
+/* Translucent fill and blit, alpha 0 (invisible) to 255 (opaque), blended at 5 bits per step. They read back what is
+ * underneath, so on the display they need buffering: -1 when unbuffered, else 0. */
+int st7735_fill_rect_alpha(st7735_t *disp, int x, int y, int w, int h, uint16_t color, uint8_t alpha);
+int st7735_blit_alpha(st7735_t *disp, int x, int y, const st7735_surface_t *surface, uint8_t alpha);
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+/* Allocate a zeroed surface. Returns NULL on failure. */
+st7735_surface_t *st7735_surface_create(int width, int height);
+void st7735_surface_destroy(st7735_surface_t *surface);
+
+/* Wrap caller-owned pixels, e.g. a region of another surface */
+void st7735_surface_init(st7735_surface_t *surface, uint16_t *pixels, int width, int height, int stride);
+
+/* Drawing into surfaces - same behaviour as the display functions */
+void st7735_surface_pixel(st7735_surface_t *surface, int x, int y, uint16_t color);
+void st7735_surface_fill(st7735_surface_t *surface, uint16_t color);
+void st7735_surface_line(st7735_surface_t *surface, int x0, int y0, int x1, int y1, uint16_t color);
+void st7735_surface_rect(st7735_surface_t *surface, int x, int y, int w, int h, uint16_t color);
+void st7735_surface_fill_rect(st7735_surface_t *surface, int x, int y, int w, int h, uint16_t color);
+void st7735_surface_circle(st7735_surface_t *surface, int x, int y, int r, uint16_t color);
+void st7735_surface_fill_circle(st7735_surface_t *surface, int x, int y, int r, uint16_t color);
+void st7735_surface_fill_polygon(st7735_surface_t *surface, const st7735_point_t *points, int count, uint16_t color);
+void st7735_surface_fill_triangle(st7735_surface_t *surface, int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color);
+void st7735_surface_fill_arc(st7735_surface_t *surface, int x, int y, int r_outer, int r_inner, int start, int end, uint16_t color);
+int st7735_surface_char(st7735_surface_t *surface, int x, int y, uint16_t fg, uint16_t bg, char c);
+int st7735_surface_text(st7735_surface_t *surface, int x, int y, uint16_t fg, uint16_t bg, int spacing, const char *str);
+#ifdef ST7735_EXTERNAL_FONTS
+int st7735_surface_char_font(st7735_surface_t *surface, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, char c);
+int st7735_surface_text_font(st7735_surface_t *surface, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, int spacing,
+                             const char *str);
+#endif
+void st7735_surface_blit(st7735_surface_t *dst, int x, int y, const st7735_surface_t *surface);
+void st7735_surface_blit_scaled(st7735_surface_t *dst, int x, int y, int w, int h, const st7735_surface_t *surface, int mode);
+void st7735_surface_blit_fit(st7735_surface_t *dst, const st7735_surface_t *surface, int mode);
+void st7735_surface_blit_rotated(st7735_surface_t *dst, int x, int y, const st7735_surface_t *surface, int rotation);
+int st7735_surface_fill_rect_alpha(st7735_surface_t *surface, int x, int y, int w, int h, uint16_t color, uint8_t alpha);
+int st7735_surface_blit_alpha(st7735_surface_t *dst, int x, int y, const st7735_surface_t *surface, uint8_t alpha);
+int st7735_surface_scroll(st7735_surface_t *surface, int x, int y, int w, int h, int dx, int dy, uint16_t fill);
+
+// ------------------------------------------------------------------------------------------------------------------------
+
+/* Display lists: record drawing commands into an arena, replay them into a display. Text is copied, fonts and surfaces
+ * are referenced and must outlive the list. Replays skip commands hidden under later opaque ones (fills, blits, text)
+ * and merge adjacent fills of the same colour. */
+typedef struct st7735_dlist st7735_dlist_t;
+
+st7735_dlist_t *st7735_dlist_create(void);
+void st7735_dlist_destroy(st7735_dlist_t *dl);
+void st7735_dlist_clear(st7735_dlist_t *dl);
+void st7735_dlist_fill(st7735_dlist_t *dl, uint16_t color);
+void st7735_dlist_fill_rect(st7735_dlist_t *dl, int x, int y, int w, int h, uint16_t color);
+void st7735_dlist_rect(st7735_dlist_t *dl, int x, int y, int w, int h, uint16_t color);
+void st7735_dlist_line(st7735_dlist_t *dl, int x0, int y0, int x1, int y1, uint16_t color);
+void st7735_dlist_circle(st7735_dlist_t *dl, int x, int y, int r, uint16_t color);
+void st7735_dlist_fill_circle(st7735_dlist_t *dl, int x, int y, int r, uint16_t color);
+void st7735_dlist_text(st7735_dlist_t *dl, int x, int y, uint16_t fg, uint16_t bg, int spacing, const char *str);
+#ifdef ST7735_EXTERNAL_FONTS
+void st7735_dlist_text_font(st7735_dlist_t *dl, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, int spacing, const char *str);
+#endif
+void st7735_dlist_blit(st7735_dlist_t *dl, int x, int y, const st7735_surface_t *surface);
+
+/* Replay a display list. With parallel rendering enabled and a framebuffer, bands are rendered across the worker
+ * threads and the call returns once all have finished, so a following flush sees the complete frame. */
+void st7735_dlist_draw(st7735_t *disp, st7735_dlist_t *dl);
+/* Replay only the region that differs from the last replay of this list into this display, comparing commands by
+ * position (surfaces by pointer). For a list cleared and re-recorded each frame; nothing else may draw there. */
+void st7735_dlist_update(st7735_t *disp, st7735_dlist_t *dl);
+
+typedef struct {
+    int y, height;
+    int worker;
+    uint32_t usec;
+} st7735_band_timing_t;
+
+/* Render display lists in horizontal bands across threads (including the caller); threads <= 1 disables,
+ * bands <= 0 picks four per thread. Returns 0 on success, -1 on failure. */
+int st7735_set_parallel(st7735_t *disp, int threads, int bands);
+/* Timings of each band from the last parallel draw. Returns the number of bands copied. */
+int st7735_parallel_timings(const st7735_t *disp, st7735_band_timing_t *timings, int max);
+
+/* Command queue for drawing from several threads: any thread enqueues onto a bounded lock-free ring and one owner
+ * thread drains it into a display list, replays it (culling and parallel bands apply) and flushes. While a queue is
+ * open only its owner may touch the display. Enqueueing never blocks: a full ring returns -1 and counts a rejection,
+ * which is the producer's backpressure signal (drop, coalesce or retry). Text is copied, non-NULL and shorter than
+ * ST7735_QUEUE_TEXT; fonts and surfaces are referenced and must outlive the command. Policy ST7735_QUEUE_DRAIN flushes
+ * after every drain; ST7735_QUEUE_FRAMES flushes only at st7735_queue_frame markers, so with a framebuffer a frame
+ * never shows half drawn. batch caps the commands rendered per drain, 0 for all pending. With frame pacing set on the
+ * display, flushes keep to its cadence: draining coalesces into the held frame, or with ST7735_QUEUE_FRAMES the owner
+ * waits for the deadline before drawing the next frame. capacity is a power of two.
+ * Destroy renders whatever is still queued, flushes and joins the owner. */
+typedef struct st7735_queue st7735_queue_t;
+
+#define ST7735_QUEUE_TEXT   40
+#define ST7735_QUEUE_DRAIN  0
+#define ST7735_QUEUE_FRAMES 1
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t depth;      /* commands waiting now */
+    uint32_t high_water; /* deepest the ring has been */
+    uint64_t commands;   /* rendered */
+    uint64_t rejected;   /* enqueues refused because the ring was full */
+    uint64_t frames;     /* frame markers drained */
+} st7735_queue_stats_t;
+
+st7735_queue_t *st7735_queue_create(st7735_t *disp, int capacity, int policy, int batch);
+void st7735_queue_destroy(st7735_queue_t *q);
+int st7735_queue_fill(st7735_queue_t *q, uint16_t color);
+int st7735_queue_fill_rect(st7735_queue_t *q, int x, int y, int w, int h, uint16_t color);
+int st7735_queue_rect(st7735_queue_t *q, int x, int y, int w, int h, uint16_t color);
+int st7735_queue_line(st7735_queue_t *q, int x0, int y0, int x1, int y1, uint16_t color);
+int st7735_queue_circle(st7735_queue_t *q, int x, int y, int r, uint16_t color);
+int st7735_queue_fill_circle(st7735_queue_t *q, int x, int y, int r, uint16_t color);
+int st7735_queue_text(st7735_queue_t *q, int x, int y, uint16_t fg, uint16_t bg, int spacing, const char *str);
+#ifdef ST7735_EXTERNAL_FONTS
+int st7735_queue_text_font(st7735_queue_t *q, int x, int y, uint16_t fg, uint16_t bg, const fontinfo_t *font, bool mono, int spacing, const char *str);
+#endif
+int st7735_queue_blit(st7735_queue_t *q, int x, int y, const st7735_surface_t *surface);
+int st7735_queue_frame(st7735_queue_t *q);
+void st7735_queue_stats(const st7735_queue_t *q, st7735_queue_stats_t *stats);
+int st7735_queue_set_realtime(st7735_queue_t *q, const st7735_realtime_t *rt);
+
+// ------------------------------------------------------------------------------------------------------------------------
+
 /* Hardware scrolling (works best with rotation=0) */
 void st7735_scroll_setup(st7735_t *disp, int top_fixed, int scroll_area, int bottom_fixed);
 void st7735_scroll(st7735_t *disp, int line);
 
+/* Software scroll/pan for any rotation: shift the framebuffer region x,y,w,h by dx,dy and fill the exposed strip,
+ * which is left for the caller to draw. The region is sent on the next flush. Returns -1 when unbuffered. */
+int st7735_scroll_region(st7735_t *disp, int x, int y, int w, int h, int dx, int dy, uint16_t fill);
+
+/* Save-under for popups (buffered only): push saves a rectangle of the framebuffer before drawing over it, pop puts
+ * the most recent one back and marks only it for the next flush. Pushes nest. Return 0 on success, -1 on failure. */
+int st7735_save_push(st7735_t *disp, int x, int y, int w, int h);
+int st7735_save_pop(st7735_t *disp);
+
+/* Scrolling log console between fixed header/footer rows, which stay free for normal drawing. Each new line costs
+ * only its own rows plus a scroll command at rotation 0/180; at 90/270 a buffered display shifts the framebuffer region
+ * instead (st7735_scroll_region) and draws just the new line, while unbuffered the visible lines are redrawn. The
+ * console owns the scroll area and flushes as it prints when buffered. Returns NULL on failure. */
+typedef struct st7735_console st7735_console_t;
+
+st7735_console_t *st7735_console_create(st7735_t *disp, int top_fixed, int bottom_fixed, uint16_t fg, uint16_t bg);
+void st7735_console_destroy(st7735_console_t *con);
+#ifdef ST7735_EXTERNAL_FONTS
+/* Use an external font (NULL for the built-in 5x7); clears the console. Returns 0 on success, -1 on failure. */
+int st7735_console_set_font(st7735_console_t *con, const fontinfo_t *font, bool mono);
+#endif
+void st7735_console_set_colors(st7735_console_t *con, uint16_t fg, uint16_t bg);
+void st7735_console_clear(st7735_console_t *con);
+/* Append text, one line per '\n'; lines wider than the screen are clipped. Returns 0 on success, -1 for NULL text or
+ * when a line could not be kept for redraws (it is still shown). */
+int st7735_console_print(st7735_console_t *con, const char *str);
+
+/* Rolling time-series chart in x,y,w,h with min/max axis labels on the left. Each column shows the min..max of
+ * `samples_per_column` samples (default 1); completing a column scrolls the plot and draws just that column when
+ * buffered. NaN samples leave gaps. Drawing goes to the display as usual: flush when ready. */
+typedef struct st7735_chart st7735_chart_t;
+
+st7735_chart_t *st7735_chart_create(st7735_t *disp, int x, int y, int w, int h, float min, float max);
+void st7735_chart_destroy(st7735_chart_t *chart);
+void st7735_chart_set_colors(st7735_chart_t *chart, uint16_t fg, uint16_t bg, uint16_t axis);
+void st7735_chart_set_range(st7735_chart_t *chart, float min, float max);
+void st7735_chart_set_decimation(st7735_chart_t *chart, int samples_per_column);
+void st7735_chart_push(st7735_chart_t *chart, float value);
+void st7735_chart_clear(st7735_chart_t *chart);
+void st7735_chart_redraw(st7735_chart_t *chart);
+
+/* Retained widgets. Setters only invalidate a widget when its state changes; st7735_ui_render draws the invalid
+ * widgets in one pass and returns how many, so a stable UI sends nothing on the next flush. Widgets belong to the
+ * ui and are freed with it. Text uses the built-in font unless set otherwise. */
+typedef struct st7735_ui st7735_ui_t;
+typedef struct st7735_widget st7735_widget_t;
+
+#define ST7735_ALIGN_LEFT   0
+#define ST7735_ALIGN_CENTER 1
+#define ST7735_ALIGN_RIGHT  2
+
+st7735_ui_t *st7735_ui_create(st7735_t *disp);
+void st7735_ui_destroy(st7735_ui_t *ui);
+int st7735_ui_render(st7735_ui_t *ui);
+/* Force a full redraw, e.g. after drawing over the widgets */
+void st7735_ui_invalidate(st7735_ui_t *ui);
+
+st7735_widget_t *st7735_label_create(st7735_ui_t *ui, int x, int y, int w, int h, uint16_t fg, uint16_t bg);
+/* Filled box with centred text */
+st7735_widget_t *st7735_badge_create(st7735_ui_t *ui, int x, int y, int w, int h, uint16_t fg, uint16_t bg);
+/* Right-aligned number formatted with a printf format for one double, e.g. "%.2f pH": exactly one %f, %e or %g with
+ * optional flags, width and precision, under 16 characters. Any other format (or NULL) falls back to "%.1f". */
+st7735_widget_t *st7735_value_create(st7735_ui_t *ui, int x, int y, int w, int h, uint16_t fg, uint16_t bg, const char *format);
+/* Horizontal bar filled left to right by st7735_widget_set_value(0..1) */
+st7735_widget_t *st7735_progress_create(st7735_ui_t *ui, int x, int y, int w, int h, uint16_t fg, uint16_t bg);
+/* Full-width text strip */
+st7735_widget_t *st7735_statusbar_create(st7735_ui_t *ui, int y, int h, uint16_t fg, uint16_t bg);
+
+void st7735_widget_set_text(st7735_widget_t *widget, const char *text);
+void st7735_widget_printf(st7735_widget_t *widget, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void st7735_widget_set_value(st7735_widget_t *widget, float value);
+void st7735_widget_set_colors(st7735_widget_t *widget, uint16_t fg, uint16_t bg);
+void st7735_widget_set_align(st7735_widget_t *widget, int align, int padding);
+#ifdef ST7735_EXTERNAL_FONTS
+void st7735_widget_set_font(st7735_widget_t *widget, const fontinfo_t *font, bool mono);
+#endif
+
 #if defined(ST7735_IMAGE_SUPPORT_BMP) || defined(ST7735_IMAGE_FORMAT_PNG) || defined(ST7735_IMAGE_SUPPORT_JPG)
 
 #ifdef ST7735_IMAGE_SUPPORT_BMP
@@ -115,6 +515,25 @@ void st7735_scroll(st7735_t *disp, int line);
 /* Draw image - returns 0 on success, -1 on error */
 int st7735_image(st7735_t *disp, int x, int y, const char *data, int size, int format, int encoding);
 int st7735_image_file(st7735_t *disp, int x, int y, const char *filename);
+int st7735_surface_image(st7735_surface_t *dst, int x, int y, const char *data, int size, int format, int encoding);
+int st7735_surface_image_file(st7735_surface_t *dst, int x, int y, const char *filename);
+
+/* Decode image to a new surface - returns NULL on error */
+st7735_surface_t *st7735_image_decode(const char *data, int size, int format, int encoding);
+st7735_surface_t *st7735_image_decode_file(const char *filename);
+
+/* Background decode on a worker pool (workers <= 0 uses cores - 1). Raw data must stay valid until the job is done.
+ * The surface returned by wait belongs to the job and is freed by release. Release all jobs before destroying the pool. */
+typedef struct st7735_prefetch st7735_prefetch_t;
+typedef struct st7735_prefetch_job st7735_prefetch_job_t;
+
+st7735_prefetch_t *st7735_prefetch_create(int workers);
+void st7735_prefetch_destroy(st7735_prefetch_t *pool);
+st7735_prefetch_job_t *st7735_prefetch_image(st7735_prefetch_t *pool, const char *data, int size, int format, int encoding);
+st7735_prefetch_job_t *st7735_prefetch_image_file(st7735_prefetch_t *pool, const char *filename);
+bool st7735_prefetch_ready(const st7735_prefetch_job_t *job);
+st7735_surface_t *st7735_prefetch_wait(st7735_prefetch_job_t *job);
+void st7735_prefetch_release(st7735_prefetch_job_t *job);
 
 #endif
 
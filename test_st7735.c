@@ -5,10 +5,35 @@
 #include <time.h>
 #include <unistd.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "fonts.h"
 #include "st7735.h"
 
+/* Test 30 producers: each thread draws its own strip through the queue */
+static atomic_bool queue_running;
+static void *queue_bars(void *arg) {
+    st7735_queue_t *q = arg;
+    for (int i = 0; atomic_load(&queue_running); i++) {
+        const int level = (int)(70 + 70 * sin(i * 0.1));
+        st7735_queue_fill_rect(q, 10, 40, level, 10, COLOR_GREEN);
+        st7735_queue_fill_rect(q, 10 + level, 40, 140 - level, 10, COLOR_BLACK);
+        usleep(10000);
+    }
+    return NULL;
+}
+static void *queue_counter(void *arg) {
+    st7735_queue_t *q = arg;
+    char text[ST7735_QUEUE_TEXT];
+    for (int i = 0; atomic_load(&queue_running); i++) {
+        snprintf(text, sizeof(text), "count %6d", i);
+        st7735_queue_text(q, 10, 60, COLOR_YELLOW, COLOR_BLACK, 1, text);
+        usleep(3000);
+    }
+    return NULL;
+}
+
 int main(int argc, char *argv[]) {
     bool use_buffer = true;
 
@@ -330,6 +355,56 @@ int main(int argc, char *argv[]) {
     end = clock();
     elapsed = (double)(end - start) / CLOCKS_PER_SEC;
     printf("%.1f FPS\n", frames / elapsed);
+    /* Test E: Display list rendered in bands across four threads */
+    if (use_buffer) {
+        printf("    E) Display list, 4 threads: ");
+        fflush(stdout);
+        st7735_dlist_t *dl = st7735_dlist_create();
+        if (dl && st7735_set_parallel(disp, 4, 0) == 0) {
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            for (frames = 0; frames < 100; frames++) {
+                st7735_dlist_clear(dl);
+                st7735_dlist_fill(dl, COLOR_BLACK);
+                for (int i = 0; i < 20; i++)
+                    st7735_dlist_fill_circle(dl, (frames * 3 + i * 17) % 160, (i * 13) % 80, 8, (uint16_t)RGB565(i * 12, 255 - i * 12, frames * 2));
+                st7735_dlist_text(dl, 5, 36, COLOR_WHITE, COLOR_BLACK, 1, "Banded render");
+                st7735_dlist_draw(disp, dl);
+                st7735_flush(disp);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            elapsed = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+            printf("%.1f FPS\n", frames / elapsed);
+            st7735_band_timing_t timings[16];
+            const int bands = st7735_parallel_timings(disp, timings, 16);
+            for (int i = 0; i < bands; i++)
+                printf("       band y=%-2d h=%d worker %d: %u us\n", timings[i].y, timings[i].height, timings[i].worker, timings[i].usec);
+            st7735_set_parallel(disp, 0, 0);
+        }
+        st7735_dlist_destroy(dl);
+    }
+    /* Test F: Retained screen re-recorded each frame, only the changed counter is redrawn */
+    printf("    F) Display list update: ");
+    fflush(stdout);
+    st7735_dlist_t *screen = st7735_dlist_create();
+    if (screen) {
+        start = clock();
+        for (frames = 0; frames < 200; frames++) {
+            st7735_dlist_clear(screen);
+            st7735_dlist_fill(screen, COLOR_BLACK);
+            st7735_dlist_fill_rect(screen, 0, 0, 160, 12, COLOR_BLUE);
+            st7735_dlist_text(screen, 2, 2, COLOR_WHITE, COLOR_BLUE, 1, "Status");
+            snprintf(fps_buf, sizeof(fps_buf), "Frame: %d", frames);
+            st7735_dlist_text(screen, 5, 36, COLOR_GREEN, COLOR_BLACK, 1, fps_buf);
+            st7735_dlist_update(disp, screen);
+            if (use_buffer)
+                st7735_flush(disp);
+        }
+        end = clock();
+        elapsed = (double)(end - start) / CLOCKS_PER_SEC;
+        printf("%.1f FPS\n", frames / elapsed);
+        st7735_dlist_destroy(screen);
+    }
     sleep(1);
 
 #if defined(ST7735_IMAGE_SUPPORT_BMP) || defined(ST7735_IMAGE_FORMAT_PNG) || defined(ST7735_IMAGE_SUPPORT_JPG)
@@ -458,8 +533,502 @@ int main(int argc, char *argv[]) {
         st7735_flush(disp);
     sleep(3);
 #endif
+
+    /* Test 19: Background decode - slideshow costs only the blit */
+    printf("[19] Background image prefetch\n");
+    st7735_prefetch_t *prefetch = st7735_prefetch_create(0);
+    if (prefetch) {
+        const char *slides[] = { "test-image.bmp", "test-image.png", "test-image.jpg" };
+        st7735_prefetch_job_t *jobs[3];
+        for (int i = 0; i < 3; i++)
+            jobs[i] = st7735_prefetch_image_file(prefetch, slides[i]);
+        for (int i = 0; i < 3; i++) {
+            const st7735_surface_t *slide = jobs[i] ? st7735_prefetch_wait(jobs[i]) : NULL;
+            if (!slide) {
+                printf("    %s prefetch FAILED\n", slides[i]);
+                continue;
+            }
+            start = clock();
+            st7735_fill(disp, COLOR_BLACK);
+            st7735_blit(disp, 0, 0, slide);
+            if (use_buffer)
+                st7735_flush(disp);
+            end = clock();
+            printf("    %s blit time: %.3f ms\n", slides[i], (double)(end - start) * 1000 / CLOCKS_PER_SEC);
+            sleep(1);
+        }
+        for (int i = 0; i < 3; i++)
+            st7735_prefetch_release(jobs[i]);
+        st7735_prefetch_destroy(prefetch);
+    }
 #endif
 
+    /* Test 20: Log console under a fixed title row */
+    printf("[20] Scrolling log console\n");
+    st7735_fill(disp, COLOR_BLACK);
+    st7735_text(disp, 2, 1, COLOR_YELLOW, COLOR_BLACK, 1, "LOG");
+    st7735_console_t *con = st7735_console_create(disp, 10, 0, COLOR_GREEN, COLOR_BLACK);
+    if (con) {
+        char line[32];
+        start = clock();
+        for (int i = 0; i < 40; i++) {
+            snprintf(line, sizeof(line), "event %d: ok", i);
+            st7735_console_print(con, line);
+            usleep(50000);
+        }
+        end = clock();
+        printf("    40 lines time: %.3f ms\n", (double)(end - start) * 1000 / CLOCKS_PER_SEC);
+        st7735_console_destroy(con);
+    }
+    sleep(1);
+
+    /* Test 21: Rolling chart, 4 samples per column */
+    printf("[21] Rolling chart\n");
+    st7735_fill(disp, COLOR_BLACK);
+    st7735_text(disp, 2, 1, COLOR_CYAN, COLOR_BLACK, 1, "pH");
+    st7735_chart_t *chart = st7735_chart_create(disp, 0, 10, st7735_width(disp), st7735_height(disp) - 10, 6.0f, 8.0f);
+    if (chart) {
+        st7735_chart_set_decimation(chart, 4);
+        start = clock();
+        for (int i = 0; i < 800; i++) {
+            st7735_chart_push(chart, 7.0f + 0.8f * sinf((float)i * 0.02f) + 0.1f * (float)(rand() % 100 - 50) / 50.0f);
+            if (use_buffer && i % 4 == 3)
+                st7735_flush(disp);
+        }
+        end = clock();
+        printf("    800 samples time: %.3f ms\n", (double)(end - start) * 1000 / CLOCKS_PER_SEC);
+        st7735_chart_destroy(chart);
+    }
+    sleep(1);
+
+    /* Test 22: Save-under popup over the chart (buffered only) */
+    printf("[22] Save-under popup\n");
+    if (use_buffer) {
+        int px = st7735_width(disp) / 2 - 40, py = st7735_height(disp) / 2 - 15;
+        start = clock();
+        for (int i = 0; i < 10; i++) {
+            st7735_save_push(disp, px, py, 80, 30);
+            st7735_fill_rect(disp, px, py, 80, 30, COLOR_BLUE);
+            st7735_rect(disp, px, py, 80, 30, COLOR_WHITE);
+            st7735_text(disp, px + 10, py + 11, COLOR_WHITE, COLOR_BLUE, 1, "ALARM");
+            st7735_flush(disp);
+            usleep(150000);
+            st7735_save_pop(disp);
+            st7735_flush(disp);
+            usleep(150000);
+        }
+        end = clock();
+        printf("    10 popups time: %.3f ms\n", (double)(end - start) * 1000 / CLOCKS_PER_SEC);
+    } else {
+        printf("    skipped (needs buffering)\n");
+    }
+    sleep(1);
+
+    /* Test 23: Viewports - the same drawing code in four clipped boxes */
+    printf("[23] Clip / viewport stack\n");
+    st7735_fill(disp, COLOR_BLACK);
+    start = clock();
+    for (int i = 0; i < 4; i++) {
+        const int vw = st7735_width(disp) / 2, vh = st7735_height(disp) / 2;
+        st7735_viewport_push(disp, (i % 2) * vw, (i / 2) * vh, vw, vh);
+        st7735_fill(disp, i % 3 ? COLOR_BLUE : COLOR_BLACK);
+        st7735_fill_circle(disp, vw - 5, vh - 5, 25, COLOR_YELLOW); /* clipped at the box edges */
+        st7735_clip_push(disp, 2, 2, vw - 4, 10);
+        st7735_text(disp, 2, 2, COLOR_WHITE, COLOR_RED, 1, "viewport clipped");
+        st7735_clip_pop(disp);
+        st7735_clip_pop(disp);
+    }
+    if (use_buffer)
+        st7735_flush(disp);
+    end = clock();
+    printf("    4 viewports time: %.3f ms\n", (double)(end - start) * 1000 / CLOCKS_PER_SEC);
+    sleep(2);
+
+    /* Test 24: Dial gauge from arcs and a triangle needle */
+    printf("[24] Polygons and arcs - dial gauge\n");
+    st7735_fill(disp, COLOR_BLACK);
+    start = clock();
+    for (int v = 0; v <= 100; v += 5) {
+        const int gx = st7735_width(disp) / 2, gy = st7735_height(disp) - 8, gr = 60;
+        st7735_fill_arc(disp, gx, gy, gr, gr - 8, 180, 270, COLOR_GREEN);
+        st7735_fill_arc(disp, gx, gy, gr, gr - 8, 270, 330, COLOR_YELLOW);
+        st7735_fill_arc(disp, gx, gy, gr, gr - 8, 330, 360, COLOR_RED);
+        st7735_fill_arc(disp, gx, gy, gr - 10, 0, 180, 360, COLOR_BLACK);
+        const float a = (180.0f + 1.8f * (float)v) * 3.14159f / 180.0f;
+        const int tx = gx + (int)((float)(gr - 12) * cosf(a)), ty = gy + (int)((float)(gr - 12) * sinf(a));
+        const int bx = (int)(4.0f * sinf(a)), by = (int)(-4.0f * cosf(a));
+        st7735_fill_triangle(disp, gx + bx, gy + by, gx - bx, gy - by, tx, ty, COLOR_WHITE);
+        st7735_fill_circle(disp, gx, gy, 5, COLOR_RED);
+        if (use_buffer)
+            st7735_flush(disp);
+        usleep(50000);
+    }
+    end = clock();
+    printf("    21 gauge frames time: %.3f ms\n", (double)(end - start) * 1000 / CLOCKS_PER_SEC);
+    sleep(2);
+
+    /* Test 25: Dim the gauge behind a translucent popup (buffered only) */
+    printf("[25] Alpha blending - dimmed background\n");
+    if (use_buffer) {
+        start = clock();
+        for (int i = 0; i < 100; i++)
+            st7735_fill_rect_alpha(disp, 0, 0, st7735_width(disp), st7735_height(disp), COLOR_BLACK, 16);
+        end = clock();
+        printf("    100 full-screen blends time: %.3f ms\n", (double)(end - start) * 1000 / CLOCKS_PER_SEC);
+        st7735_fill_rect_alpha(disp, 20, 20, st7735_width(disp) - 40, st7735_height(disp) - 40, COLOR_BLUE, 160);
+        st7735_text(disp, 30, 36, COLOR_WHITE, COLOR_BLUE, 1, "translucent");
+        st7735_flush(disp);
+    } else {
+        printf("    skipped (needs buffering)\n");
+    }
+    sleep(2);
+
+    /* Test 26: 4 bpp palette framebuffer, recoloured by palette swaps alone */
+    printf("[26] Indexed colour - 16 entry palette\n");
+    if (use_buffer) {
+        const uint16_t day[16] = { COLOR_BLACK, COLOR_WHITE, COLOR_RED, COLOR_GREEN, COLOR_BLUE, COLOR_YELLOW, COLOR_CYAN, COLOR_MAGENTA };
+        const uint16_t night[16] = { COLOR_BLACK, COLOR_RED, RGB565(96, 0, 0), RGB565(128, 0, 0), RGB565(64, 0, 0), RGB565(160, 0, 0), RGB565(96, 0, 0), RGB565(128, 0, 0) };
+        st7735_set_indexed(disp, 4, day, 8);
+        st7735_fill(disp, COLOR_BLACK);
+        for (int i = 0; i < 6; i++)
+            st7735_fill_rect(disp, 5 + i * 25, 5, 20, 40, day[2 + i]);
+        st7735_text(disp, 5, 60, COLOR_WHITE, COLOR_BLACK, 1, "palette swap");
+        start = clock();
+        st7735_flush(disp);
+        end = clock();
+        printf("    4 bpp flush time: %.3f ms\n", (double)(end - start) * 1000 / CLOCKS_PER_SEC);
+        for (int i = 0; i < 6; i++) {
+            sleep(1);
+            st7735_set_palette(disp, i % 2 ? day : night, 8);
+            st7735_flush(disp);
+        }
+        st7735_set_indexed(disp, 0, NULL, 0);
+    } else {
+        printf("    skipped (needs buffering)\n");
+    }
+    sleep(1);
+
+    /* Test 27: Full-frame flush with byte-swapped 8 bit transfers vs native 16 bit words */
+    printf("[27] SPI word size - flush benchmark\n");
+    if (use_buffer) {
+        const bool word16 = st7735_is_word16(disp);
+        for (int mode = 0; mode < 2; mode++) {
+            if (st7735_set_word16(disp, mode == 1) < 0) {
+                printf("    16 bit words: not supported by the SPI controller\n");
+                break;
+            }
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            for (int i = 0; i < 50; i++) {
+                st7735_fill(disp, i % 2 ? COLOR_RED : COLOR_BLUE);
+                st7735_flush(disp);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            start = clock();
+            for (int i = 0; i < 50; i++) {
+                st7735_invalidate(disp, 0, 0, st7735_width(disp), st7735_height(disp));
+                st7735_flush(disp);
+            }
+            end = clock();
+            printf("    %s: %.3f ms/frame wall, %.3f ms/frame cpu\n", mode ? "16 bit words" : "8 bit bytes",
+                   ((double)(t1.tv_sec - t0.tv_sec) * 1000 + (double)(t1.tv_nsec - t0.tv_nsec) / 1e6) / 50,
+                   (double)(end - start) * 1000 / CLOCKS_PER_SEC / 50);
+        }
+        st7735_set_word16(disp, word16);
+    } else {
+        printf("    skipped (needs buffering)\n");
+    }
+    sleep(1);
+
+    /* Test 28: Pixel clock candidates, throughput measured on the bus */
+    printf("[28] SPI clock - throughput probe\n");
+    if (use_buffer) {
+        const uint32_t speeds[] = { 8000000, 16000000, 24000000, 32000000 };
+        st7735_speed_probe_t probes[4];
+        st7735_fill(disp, COLOR_BLACK);
+        st7735_text(disp, 5, 5, COLOR_WHITE, COLOR_BLACK, 1, "SPI clock probe");
+        if (st7735_probe_speeds(disp, speeds, 4, 20, probes) == 4)
+            for (int i = 0; i < 4; i++)
+                printf("    %2u MHz: %7.1f KB/s, %.3f ms/frame\n", probes[i].speed_hz / 1000000,
+                       (double)probes[i].bytes_per_sec / 1024, (double)probes[i].usec_per_frame / 1000);
+    } else {
+        printf("    skipped (needs buffering)\n");
+    }
+    sleep(1);
+
+    /* Test 29: 12 bit interface, 4-4-4 colour at three bytes per two pixels */
+    printf("[29] 12 bit colour - gradient and flush timing\n");
+    if (use_buffer) {
+        for (int y = 0; y < st7735_height(disp); y++) {
+            const int v = y * 255 / st7735_height(disp);
+            st7735_fill_rect(disp, 0, y, st7735_width(disp), 1, (uint16_t)RGB565(v, 255 - v, 128));
+        }
+        for (int depth = 16; depth >= 12; depth -= 4) {
+            st7735_set_color_depth(disp, depth);
+            struct timespec t0, t1;
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            for (int i = 0; i < 50; i++) {
+                st7735_invalidate(disp, 0, 0, st7735_width(disp), st7735_height(disp));
+                st7735_flush(disp);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            printf("    %d bit: %.3f ms/frame\n", depth,
+                   ((double)(t1.tv_sec - t0.tv_sec) * 1000 + (double)(t1.tv_nsec - t0.tv_nsec) / 1e6) / 50);
+            sleep(1);
+        }
+        st7735_set_color_depth(disp, 16);
+    } else {
+        printf("    skipped (needs buffering)\n");
+    }
+    sleep(1);
+
+    /* Test 30: Two threads drawing through the command queue, frames cut by the main thread */
+    printf("[30] Command queue - multi-threaded drawing\n");
+    st7735_queue_t *queue = st7735_queue_create(disp, 256, ST7735_QUEUE_FRAMES, 0);
+    if (queue) {
+        pthread_t producers[2];
+        st7735_queue_fill(queue, COLOR_BLACK);
+        st7735_queue_text(queue, 10, 10, COLOR_WHITE, COLOR_BLACK, 1, "Queue: 2 threads");
+        atomic_store(&queue_running, true);
+        pthread_create(&producers[0], NULL, queue_bars, queue);
+        pthread_create(&producers[1], NULL, queue_counter, queue);
+        for (int i = 0; i < 100; i++) {
+            st7735_queue_frame(queue);
+            usleep(20000);
+        }
+        atomic_store(&queue_running, false);
+        pthread_join(producers[0], NULL);
+        pthread_join(producers[1], NULL);
+        st7735_queue_stats_t stats;
+        st7735_queue_stats(queue, &stats);
+        st7735_queue_destroy(queue);
+        printf("    %llu commands in %llu frames, high water %u/%u, %llu rejected\n", (unsigned long long)stats.commands,
+               (unsigned long long)stats.frames, stats.high_water, stats.capacity, (unsigned long long)stats.rejected);
+    }
+    sleep(1);
+
+    /* Test 31: Paced animation at 30 fps with the panel refresh matched, plus a burst of flushes coalesced */
+    printf("[31] Frame pacing - 30 fps\n");
+    if (use_buffer) {
+        st7735_set_frame_rate(disp, 30, true);
+        st7735_fill(disp, COLOR_BLACK);
+        for (int i = 0; i < 90; i++) {
+            st7735_fill_rect(disp, 0, 30, st7735_width(disp), 20, COLOR_BLACK);
+            st7735_fill_rect(disp, (i * 4) % (st7735_width(disp) - 20), 30, 20, 20, COLOR_CYAN);
+            st7735_frame(disp);
+        }
+        for (int i = 0; i < 1000; i++) {
+            st7735_pixel(disp, i % st7735_width(disp), 60 + i / st7735_width(disp), COLOR_WHITE);
+            st7735_flush(disp);
+        }
+        const bool held = st7735_frame_pending(disp);
+        st7735_frame(disp);
+        printf("    end of burst: %s, after st7735_frame: %s\n", held ? "held" : "sent",
+               st7735_frame_pending(disp) ? "still held (FAIL)" : "sent");
+        st7735_frame_stats_t stats;
+        st7735_frame_stats(disp, &stats);
+        printf("    panel %.2f Hz, %llu frames, %llu missed, %llu flushes coalesced, worst late %u us, worst flush %u us\n",
+               stats.panel_centihz / 100.0, (unsigned long long)stats.frames, (unsigned long long)stats.missed,
+               (unsigned long long)stats.coalesced, stats.late_max_us, stats.flush_max_us);
+        st7735_set_frame_rate(disp, 0, true);
+    } else {
+        printf("    skipped (needs buffering)\n");
+    }
+    sleep(1);
+
+    /* Test 32: Full-screen flushes on a SCHED_FIFO thread with memory locked, latency distribution */
+    printf("[32] Real-time flush - SCHED_FIFO 50, locked memory\n");
+    if (use_buffer) {
+        const st7735_realtime_t rt = { .priority = 50, .cpu = -1, .lock_memory = true };
+        if (st7735_set_realtime(disp, &rt) < 0)
+            printf("    not permitted, measuring at normal priority\n");
+        for (int i = 0; i < 200; i++) {
+            st7735_fill_rect(disp, 0, 0, st7735_width(disp), st7735_height(disp), (i & 1) ? COLOR_BLUE : COLOR_BLACK);
+            st7735_flush(disp);
+        }
+        st7735_latency_t lat;
+        st7735_flush_latency(disp, &lat);
+        printf("    %llu full-screen flushes: min %u us, mean %u us, p50 %u us, p99 %u us, max %u us\n",
+               (unsigned long long)lat.count, lat.min_us, lat.mean_us, lat.p50_us, lat.p99_us, lat.max_us);
+        st7735_clear_realtime(disp);
+    } else {
+        printf("    skipped (needs buffering)\n");
+    }
+    sleep(1);
+
+    /* Test 33: Per-display counters and flush cost for a run of partial updates */
+    printf("[33] Driver statistics - 50 partial updates\n");
+    if (use_buffer) {
+        st7735_stats_reset(disp);
+        for (int i = 0; i < 50; i++) {
+            st7735_fill_rect(disp, (i * 3) % (st7735_width(disp) - 16), 20, 16, 16, (i & 1) ? COLOR_GREEN : COLOR_RED);
+            st7735_flush(disp);
+        }
+        st7735_stats_t stats;
+        st7735_stats_get(disp, &stats);
+        printf("    %llu ioctls, %llu bytes, %llu commands, %llu windows, %llu pixels, %llu flushes\n",
+               (unsigned long long)stats.ioctls, (unsigned long long)stats.bytes, (unsigned long long)stats.commands,
+               (unsigned long long)stats.windows, (unsigned long long)stats.pixels, (unsigned long long)stats.flushes);
+        printf("    flush: %llu us converting, %llu us transferring, p99 %u us\n",
+               (unsigned long long)stats.flush_convert_us, (unsigned long long)stats.flush_transfer_us,
+               stats.flush_latency.p99_us);
+    } else {
+        printf("    skipped (needs buffering)\n");
+    }
+    sleep(1);
+
+    /* Test 34: Flush stages of 30 frames traced and written as Chrome trace JSON */
+    printf("[34] Timeline trace - 30 frames to /tmp/st7735_trace.json\n");
+    if (use_buffer) {
+        st7735_trace_start(disp, 1024);
+        for (int i = 0; i < 30; i++) {
+            const uint64_t begin = st7735_trace_begin(disp);
+            st7735_fill_rect(disp, 0, 40, st7735_width(disp), 16, COLOR_BLACK);
+            st7735_fill_rect(disp, (i * 5) % (st7735_width(disp) - 16), 40, 16, 16, COLOR_YELLOW);
+            st7735_trace_end(disp, begin, "draw");
+            st7735_flush(disp);
+        }
+        st7735_trace_stop(disp);
+        const int events = st7735_trace_dump(disp, "/tmp/st7735_trace.json");
+        printf("    %d events written, open in chrome://tracing or ui.perfetto.dev\n", events);
+    } else {
+        printf("    skipped (needs buffering)\n");
+    }
+    sleep(1);
+
+    /* Test 35: Scaled blits, nearest vs box filter, and a flat colour that must survive 3:1 averaging unchanged */
+    printf("[35] Scaled blit - nearest and box filter\n");
+    st7735_surface_t *pattern = st7735_surface_create(96, 48);
+    st7735_surface_t *flat = st7735_surface_create(9, 3);
+    st7735_surface_t *shrunk = st7735_surface_create(3, 3);
+    if (pattern && flat && shrunk) {
+        for (int y = 0; y < 48; y++)
+            for (int x = 0; x < 96; x++)
+                st7735_surface_pixel(pattern, x, y, ((x / 3 + y / 3) & 1) ? COLOR_WHITE : (uint16_t)RGB565(x * 2, y * 5, 128));
+        st7735_fill(disp, COLOR_BLACK);
+        start = clock();
+        st7735_blit_scaled(disp, 0, 0, st7735_width(disp) / 2, st7735_height(disp), pattern, ST7735_SCALE_NEAREST);
+        st7735_blit_scaled(disp, st7735_width(disp) / 2, 0, 32, 16, pattern, ST7735_SCALE_BOX);
+        end = clock();
+        if (use_buffer)
+            st7735_flush(disp);
+        st7735_surface_fill(flat, COLOR_WHITE);
+        st7735_surface_blit_scaled(shrunk, 0, 0, 3, 3, flat, ST7735_SCALE_BOX);
+        printf("    scale time: %.3f ms, white box-averaged 3:1 -> %04X (%s)\n", (double)(end - start) * 1000 / CLOCKS_PER_SEC,
+               shrunk->pixels[0], shrunk->pixels[0] == COLOR_WHITE ? "ok" : "FAIL");
+    }
+    st7735_surface_destroy(pattern);
+    st7735_surface_destroy(flat);
+    st7735_surface_destroy(shrunk);
+    sleep(1);
+
+    /* Test 36: Partial-width dirty region flushed as batched SPI_IOC_MESSAGE transfers, one per row with 16 bit words */
+    printf("[36] Scatter-gather flush - 80x60 dirty region\n");
+    if (use_buffer) {
+        const bool word16 = st7735_is_word16(disp);
+        if (st7735_set_word16(disp, true) < 0)
+            printf("    16 bit words not supported: rows are staged in one buffer instead\n");
+        st7735_fill(disp, COLOR_BLACK);
+        st7735_flush(disp);
+        st7735_stats_reset(disp);
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (int i = 0; i < 50; i++) {
+            st7735_fill_rect(disp, 40, 10, 80, 60, i % 2 ? COLOR_MAGENTA : COLOR_CYAN);
+            st7735_flush(disp);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        st7735_stats_t stats;
+        st7735_stats_get(disp, &stats);
+        printf("    %.1f ioctls/flush, %.3f ms/flush wall, %.1f KB/s on the bus\n", (double)stats.ioctls / 50,
+               ((double)(t1.tv_sec - t0.tv_sec) * 1000 + (double)(t1.tv_nsec - t0.tv_nsec) / 1e6) / 50,
+               stats.transfer_us ? (double)stats.bytes * 1e6 / (double)stats.transfer_us / 1024 : 0.0);
+        st7735_set_word16(disp, word16);
+    } else {
+        printf("    skipped (needs buffering)\n");
+    }
+    sleep(1);
+
+    /* Test 37: Text widget updates sharing a prefix, only the changed glyph cells redrawn */
+    printf("[37] Widget glyph diff - \"7.12 pH\" to \"7.13 pH\"\n");
+    if (use_buffer) {
+        st7735_fill(disp, COLOR_BLACK);
+        st7735_ui_t *ui = st7735_ui_create(disp);
+        st7735_widget_t *reading = ui ? st7735_label_create(ui, 10, 30, 100, 16, COLOR_WHITE, COLOR_BLUE) : NULL;
+        if (reading) {
+            st7735_widget_set_text(reading, "7.12 pH");
+            st7735_ui_render(ui);
+            st7735_flush(disp);
+            const char *readings[] = { "7.13 pH", "7.14 pH", "7.24 pH", "7.24 pH" };
+            for (int i = 0; i < 4; i++) {
+                st7735_stats_reset(disp);
+                st7735_widget_set_text(reading, readings[i]);
+                const int rendered = st7735_ui_render(ui);
+                st7735_flush(disp);
+                st7735_stats_t stats;
+                st7735_stats_get(disp, &stats);
+                printf("    -> %s: %d widget redrawn, %llu pixels sent\n", readings[i], rendered, (unsigned long long)stats.pixels);
+                usleep(300000);
+            }
+        }
+        st7735_ui_destroy(ui);
+    } else {
+        printf("    skipped (needs buffering)\n");
+    }
+    sleep(1);
+
+    /* Test 38: Offscreen surface composed with the drawing calls, a sub-region view, then blitted as a sprite */
+    printf("[38] Offscreen surface - compose and blit\n");
+    st7735_surface_t *card = st7735_surface_create(48, 32);
+    if (card) {
+        start = clock();
+        st7735_surface_fill(card, COLOR_BLUE);
+        st7735_surface_rect(card, 0, 0, 48, 32, COLOR_WHITE);
+        st7735_surface_fill_circle(card, 12, 16, 8, COLOR_YELLOW);
+        st7735_surface_line(card, 24, 4, 44, 28, COLOR_RED);
+        st7735_surface_text(card, 24, 4, COLOR_WHITE, COLOR_BLUE, 1, "OK");
+        /* right half as its own surface: drawing there is clipped to it and lands in card's pixels */
+        st7735_surface_t half;
+        st7735_surface_init(&half, card->pixels + 24, 24, 32, card->stride);
+        st7735_surface_fill_rect(&half, 0, 20, 40, 20, COLOR_GREEN);
+        const clock_t composed = clock();
+        st7735_fill(disp, COLOR_BLACK);
+        for (int i = 0; i < 6; i++)
+            st7735_blit(disp, (i % 3) * 52 + 2, (i / 3) * 38 + 4, card);
+        if (use_buffer)
+            st7735_flush(disp);
+        end = clock();
+        printf("    compose %.3f ms, 6 blits + flush %.3f ms\n", (double)(composed - start) * 1000 / CLOCKS_PER_SEC,
+               (double)(end - composed) * 1000 / CLOCKS_PER_SEC);
+        st7735_surface_destroy(card);
+    }
+    sleep(1);
+
+    /* Test 39: Chart and console fed while a viewport is pushed: both must stay in screen coordinates */
+    printf("[39] Chart and console under a viewport\n");
+    st7735_fill(disp, COLOR_BLACK);
+    st7735_text(disp, 2, 1, COLOR_YELLOW, COLOR_BLACK, 1, "Viewport + retained objects");
+    st7735_console_t *vcon = st7735_console_create(disp, 10, st7735_height(disp) / 2, COLOR_GREEN, COLOR_BLACK);
+    st7735_chart_t *vchart = st7735_chart_create(disp, 0, st7735_height(disp) / 2, st7735_width(disp), st7735_height(disp) / 2, -1.0f, 1.0f);
+    if (vcon && vchart) {
+        st7735_viewport_push(disp, 40, 20, 40, 20);
+        st7735_fill(disp, COLOR_BLUE); /* only the viewport box turns blue */
+        for (int i = 0; i < 60; i++) {
+            st7735_chart_push(vchart, sinf((float)i * 0.2f));
+            if (i % 10 == 0) {
+                char line[32];
+                snprintf(line, sizeof(line), "sample %d", i);
+                st7735_console_print(vcon, line);
+            }
+        }
+        st7735_clip_pop(disp);
+        if (use_buffer)
+            st7735_flush(disp);
+    }
+    st7735_chart_destroy(vchart);
+    st7735_console_destroy(vcon);
+    sleep(1);
+
     printf("\n=== Test Complete ===\n");
     st7735_close(disp);
     return 0;